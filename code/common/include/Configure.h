@@ -37,6 +37,14 @@ namespace Eulerian2dPara
     extern float boussinesqAlpha;
     extern float boussinesqBeta;
     extern float vorticityConst;
+
+    extern int pressureSolver;
+    extern int preconditioner;
+    extern float pressureTolerance;
+    extern bool relativeTolerance;
+    extern int pressureIterations;
+    extern float pressureResidual;
+    extern float pressureTime;
 }
 
 namespace Eulerian3dPara
@@ -69,11 +77,20 @@ namespace Eulerian3dPara
     extern float boussinesqBeta;
     extern float vorticityConst;
 
+    extern int pressureSolver;
+    extern int preconditioner;
+    extern float pressureTolerance;
+    extern bool relativeTolerance;
+    extern int pressureIterations;
+    extern float pressureResidual;
+    extern float pressureTime;
+
 }
 
 namespace Lagrangian2dPara
 {
     extern float scale;
+    extern unsigned int seed;
     extern float dt;
     extern int substep;
     extern float maxVelocity;
@@ -89,11 +106,35 @@ namespace Lagrangian2dPara
     extern float stiffness;
     extern float exponent;
     extern float viscosity;
+
+    extern int threads;
+    extern bool benchmarkBlockSort;
+    extern bool neighborList;
+    extern float neighborSkin;
+
+    extern bool kernelInterpolation;
+    extern bool pairStream;
+    extern bool adaptiveTimeStep;
+    extern float frameTime;
+    extern float cflNumber;
+    extern float minDt;
+    extern float maxDt;
+    extern float stepDt;
+    extern int frameSteps;
+
+    extern bool emitters;
+    extern int maxParticleNum;
+    const int PARTICLE_NUM_HISTORY = 200;
+    extern int particleNum;
+    extern float emissionTime;
+    extern float particleNumHistory[PARTICLE_NUM_HISTORY];
+    extern int particleNumHistoryOffset;
 }
 
 namespace Lagrangian3dPara
 {
     extern float scale;
+    extern unsigned int seed;
     extern float dt;
     extern int substep;
     extern float maxVelocity;
@@ -113,6 +154,45 @@ namespace Lagrangian3dPara
     extern float exponent;
     extern float viscosity;
 
+    extern int threads;
+    extern bool benchmarkBlockSort;
+    extern bool neighborList;
+    extern float neighborSkin;
+    extern int blockOrder;
+    extern bool sparseGrid;
+    extern int simd;
+    extern bool pairStream;
+    extern bool adaptiveTimeStep;
+    extern float frameTime;
+    extern float cflNumber;
+    extern float minDt;
+    extern float maxDt;
+    extern float stepDt;
+    extern int frameSteps;
+
+    extern int pressureSolver;
+    extern float densityTolerance;
+    extern float divergenceTolerance;
+    extern int maxPressureIterations;
+    extern int densityIterations;
+    extern int divergenceIterations;
+    extern float densityError;
+    extern bool benchmarkPressureSolver;
+
+    extern bool emitters;
+    extern int maxParticleNum;
+    const int PARTICLE_NUM_HISTORY = 200;
+    extern int particleNum;
+    extern float emissionTime;
+    extern float particleNumHistory[PARTICLE_NUM_HISTORY];
+    extern int particleNumHistoryOffset;
+
+    extern bool sleepingBlocks;
+    extern float sleepVelocity;
+    extern float sleepAccleration;
+    extern int sleepSteps;
+    extern float activeFraction;
+
     extern float IOR;
     extern float IOR_BIAS;
     extern glm::vec3 F0;
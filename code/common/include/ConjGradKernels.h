@@ -0,0 +1,30 @@
+#pragma once
+#ifndef __CONJGRAD_KERNELS_H__
+#define __CONJGRAD_KERNELS_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// Vector kernels of the conjugate gradient loops, each one a single multithreaded pass.
+	// Reductions are summed per fixed block of CG_REDUCTION_BLOCK entries and the block
+	// sums are then added in order, so the result does not depend on the thread count.
+	const int CG_REDUCTION_BLOCK = 4096;
+
+	// inner_prod(x, y)
+	double cg_dot(const ublas::vector<double>& x, const ublas::vector<double>& y);
+
+	// p += alpha * s, r -= alpha * z, returns inner_prod(r, r)
+	double cg_update(double alpha, const ublas::vector<double>& s, const ublas::vector<double>& z, ublas::vector<double>& p, ublas::vector<double>& r);
+
+	// s = z + beta * s
+	void cg_xpby(const ublas::vector<double>& z, double beta, ublas::vector<double>& s);
+
+	// Sum of per-block partial results in a fixed order
+	double cg_sum(const double* partial, int count);
+}
+
+#endif
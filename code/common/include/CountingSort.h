@@ -0,0 +1,36 @@
+#pragma once
+#ifndef __COUNTING_SORT_H__
+#define __COUNTING_SORT_H__
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Glb {
+
+	// CountingSort sorts small bounded integer keys, such as the block ids of a
+	// uniform neighbour grid, in O(n + numKeys).
+	// The keys are split into one contiguous chunk per thread. Every chunk counts its
+	// keys, a prefix sum over (key, chunk) gives each chunk its first slot per key, and
+	// the chunks scatter their indices in parallel. Chunks keep their input order, so
+	// the sort is stable and the result does not depend on the thread count.
+	// The histogram and the outputs keep their storage between calls.
+	class CountingSort
+	{
+	public:
+		CountingSort();
+		~CountingSort();
+
+		// order[i] is the index of the key that sorts to position i, and the keys equal
+		// to b sit at [extents[b].x, extents[b].y). Keys outside [0, numKeys) are placed
+		// after all the others and get no extent. threads = 0 uses every core
+		void sort(const std::vector<uint32_t>& keys, int numKeys, int threads,
+				  std::vector<uint32_t>& order, std::vector<glm::uvec2>& extents);
+
+	protected:
+		std::vector<uint32_t> mCounts;	// per chunk, one count and then one offset per key
+		std::vector<uint32_t> mTotals;	// per key, number of keys and then first slot
+	};
+}
+
+#endif
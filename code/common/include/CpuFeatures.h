@@ -0,0 +1,35 @@
+#pragma once
+#ifndef __CPU_FEATURES_H__
+#define __CPU_FEATURES_H__
+
+// Functions built for a wider instruction set than the rest of the project. MSVC
+// emits any intrinsic without special flags, GCC and Clang need the target attribute.
+// Only call them after checking the matching CpuFeatures flag
+#if defined(_MSC_VER)
+#define GLB_TARGET_AVX2
+#define GLB_TARGET_AVX512
+#else
+#define GLB_TARGET_AVX2 __attribute__((target("avx2")))
+#define GLB_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace Glb {
+
+	// Instruction sets usable on this machine, read once from CPUID. A set only counts
+	// when the OS also saves its registers on context switches (XGETBV)
+	class CpuFeatures
+	{
+	public:
+		static bool hasAVX2();		// AVX2 with 256 bit gathers
+		static bool hasAVX512();	// AVX-512 Foundation
+
+	private:
+		CpuFeatures();
+		static const CpuFeatures& get();
+
+		bool mAVX2;
+		bool mAVX512;
+	};
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef __DCT_H__
+#define __DCT_H__
+
+#include <complex>
+#include <vector>
+
+namespace Glb {
+
+	// DCT computes the unnormalized DCT-II of one line of n samples,
+	//   X[k] = sum_i x[i] * cos(pi * k * (2 * i + 1) / (2 * n)),
+	// and its inverse, in O(n log n). Both go through a complex FFT of length n
+	// (Makhoul's reordering). The FFT is mixed radix for lengths whose prime factors
+	// are at most MAX_RADIX, other lengths use Bluestein's algorithm on top of a
+	// power-of-two FFT.
+	// The plan is read-only after init, so several threads may share it as long as
+	// each one passes its own work buffer.
+	class DCT
+	{
+	public:
+		typedef std::complex<double> Complex;
+
+		static const int MAX_RADIX = 7;
+
+		DCT();
+		~DCT();
+
+		void init(int n);
+		int size() const;
+
+		// Number of Complex entries the work buffer must hold
+		int workSize() const;
+
+		// x = DCT-II(x)
+		void forward(double* x, Complex* work) const;
+
+		// x = DCT-II^-1(x)
+		void inverse(double* x, Complex* work) const;
+
+	protected:
+		struct FFTPlan
+		{
+			int n;
+			std::vector<int> factors;
+			std::vector<Complex> twiddle;	// exp(-2 pi i k / n)
+
+			void init(int n);
+			void run(const Complex* in, Complex* out) const;
+			void recurse(const Complex* in, int stride, Complex* out, int n, int level) const;
+		};
+
+		// out = FFT(in), the length mSize DFT
+		void fft(const Complex* in, Complex* out, Complex* work) const;
+
+		int mSize;
+		bool mBluestein;
+		FFTPlan mPlan;					// length mSize, or the Bluestein padding
+		std::vector<Complex> mShift;	// exp(-pi i k / (2 * mSize))
+		std::vector<Complex> mChirp;	// Bluestein only: exp(-pi i k^2 / mSize)
+		std::vector<Complex> mKernel;	// Bluestein only: FFT of the conjugate chirp
+	};
+}
+
+#endif
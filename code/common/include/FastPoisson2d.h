@@ -0,0 +1,42 @@
+#pragma once
+#ifndef __FAST_POISSON_2D_H__
+#define __FAST_POISSON_2D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "DCT.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// FastPoisson2d ûڲʱѹģֱ
+	// ߽ʹ˹ӳΪ Neumann ⣬ÿ DCT-II ԽԽǻ
+	// ÿֵΪ 2 - 2 cos(pi * k / n)
+	// һΪ任Ԫ任Ӷ O(N log N)Ҫ
+	// ģ̬ģֱ㣬Ӱѹݶ
+	// Ԫ± MACGrid2d ͬ (i + j * dimX)
+	class FastPoisson2d
+	{
+	public:
+		FastPoisson2d();
+		~FastPoisson2d();
+
+		void build(int dimX, int dimY);
+
+		// x = A^-1 * bA еԪ
+		void solve(const ublas::vector<double>& b, ublas::vector<double>& x);
+
+		int dim[2];
+
+	protected:
+		void transform(double* x, int axis, bool inverse);
+
+		DCT mDCT[2];
+		std::vector<double> mEigen[2];
+	};
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef __FAST_POISSON_3D_H__
+#define __FAST_POISSON_3D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "DCT.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// FastPoisson3d is a direct solver for the pressure stencil of a box that has no
+	// solid cells except its walls. The walls make the Laplacian a Neumann problem,
+	// which the DCT-II along each axis diagonalizes with eigenvalues
+	// 2 - 2 cos(pi * k / n) per axis. One solve is a forward transform, a division
+	// per cell and an inverse transform, O(N log N) with no iterations.
+	// The constant mode is singular and set to zero, it does not change the gradient.
+	// Cells use the same linear index as MACGrid3d (i + k * dimX + j * dimX * dimZ).
+	class FastPoisson3d
+	{
+	public:
+		FastPoisson3d();
+		~FastPoisson3d();
+
+		void build(int dimX, int dimY, int dimZ);
+
+		// x = A^-1 * b for the stencil with every cell fluid
+		void solve(const ublas::vector<double>& b, ublas::vector<double>& x);
+
+		int dim[3];
+
+	protected:
+		void transform(double* x, int axis, bool inverse);
+
+		DCT mDCT[3];
+		std::vector<double> mEigen[3];
+	};
+}
+
+#endif
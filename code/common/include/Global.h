@@ -2,6 +2,7 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 #include <chrono>
+#include <cstdint>
 #include <random>
 #include <unordered_map>
 #include <glm/glm.hpp>
@@ -99,15 +100,36 @@ namespace Glb {
     };
 
 
-    class RandomGenerator {
-    private:
-        std::random_device dev;
+    // Counter-based random numbers (Widynski's Squares): the n-th number is a pure
+    // function of n and a key derived from the seed, so it can be drawn in any order
+    // and from any thread, and a seed always gives the same sequence
+    class CounterRandom {
     public:
-        float GetUniformRandom(float min = 0.0f, float max = 1.0f) {
-            std::mt19937 rng(dev());
-            std::uniform_real_distribution<float> dist(min, max); // distribution in range [min, max]
-            return dist(rng);
+        explicit CounterRandom(uint64_t seed) {
+            // splitmix64 spreads the bits of small seeds, Squares wants an odd key
+            uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            mKey = (z ^ (z >> 31)) | 1;
+        }
+
+        uint32_t Get(uint64_t counter) const {
+            uint64_t x = counter * mKey;
+            uint64_t y = x;
+            uint64_t z = y + mKey;
+            x = x * x + y; x = (x >> 32) | (x << 32);
+            x = x * x + z; x = (x >> 32) | (x << 32);
+            x = x * x + y; x = (x >> 32) | (x << 32);
+            return (uint32_t)((x * x + z) >> 32);
         }
+
+        // uniform in [min, max), from the top 24 bits
+        float GetUniform(uint64_t counter, float min = 0.0f, float max = 1.0f) const {
+            return min + (max - min) * (float)(Get(counter) >> 8) * (1.0f / 16777216.0f);
+        }
+
+    private:
+        uint64_t mKey;
     };
 
     static glm::vec4 ProjToIntrinsic(glm::mat4 projection, float w, float h) {
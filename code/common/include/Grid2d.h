@@ -0,0 +1,242 @@
+#pragma once
+#ifndef __GRID_2D_H__
+#define __GRID_2D_H__
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Glb {
+
+	// Grid2d λãԪģߴֱ xy ıߵе㣨÷ϱȵԪһ㣩
+	struct Stagger2d
+	{
+		enum Type
+		{
+			Cell,
+			FaceX,
+			FaceY
+		};
+	};
+
+	// Grid2d ÿ T ݴ洢
+	//  i  x Ӷӣ j  y Ӷӣ MACGrid2d ͬ
+	//
+	// ܸ GHOST ĬֵⵥԪ operator() ֻ±㣬Խ飬
+	// ģֵԶȡ GHOST 
+	// дڲڱϵinterpolate() ϰ±е߽㣬ÿβֵֻһ
+	//
+	// ռߴ (0,0) 쵽 mMaxһλãinterpolate() Ĭֵ
+	template <typename T, int S = Stagger2d::Cell>
+	class Grid2d
+	{
+	public:
+		static const int GHOST = 3;
+
+		Grid2d() : cellSize(0.0f), mMax(0.0f), mDfltValue(T())
+		{
+			dim[0] = dim[1] = 0;
+			mOrigin = mStrideJ = 0;
+		}
+
+		//  dimX * dimY Ԫ㣬 dfltValue 
+		void initialize(const int cells[2], float cellSize, T dfltValue = T())
+		{
+			this->cellSize = cellSize;
+			for (int a = 0; a < 2; a++)
+			{
+				dim[a] = cells[a];
+				mSamples[a] = cells[a] + (isFace(a) ? 1 : 0);
+				mMax[a] = cellSize * mSamples[a];
+			}
+
+			int padX = mSamples[0] + 2 * GHOST;
+			int padY = mSamples[1] + 2 * GHOST;
+			mStrideJ = padX;
+			mOrigin = GHOST + GHOST * mStrideJ;
+			mData.assign(padX * padY, dfltValue);
+			mDfltValue = dfltValue;
+		}
+
+		//  dfltValue 䣬ⵥԪ
+		void initialize(T dfltValue)
+		{
+			mDfltValue = dfltValue;
+			std::fill(mData.begin(), mData.end(), dfltValue);
+		}
+
+		T& operator()(int i, int j)
+		{
+			assert(inBand(i, j));
+			return mData[mOrigin + i + j * mStrideJ];
+		}
+
+		const T& operator()(int i, int j) const
+		{
+			assert(inBand(i, j));
+			return mData[mOrigin + i + j * mStrideJ];
+		}
+
+		// ڵĵԪԼڸõԪڵλãֻȡĲλúͳߴ磬
+		// ͬһϵĶԹһβ
+		struct Location
+		{
+			int i, j;
+			double fractx, fracty;
+		};
+
+		void locate(const glm::vec2& pt, Location& loc) const
+		{
+			glm::vec2 pos = worldToSelf(pt);
+
+			loc.i = (int)(pos[0] / cellSize);
+			loc.j = (int)(pos[1] / cellSize);
+
+			double scale = 1.0 / cellSize;
+			loc.fractx = scale * (pos[0] - loc.i * cellSize);
+			loc.fracty = scale * (pos[1] - loc.j * cellSize);
+
+			assert(loc.fractx < 1.0 && loc.fractx >= 0);
+			assert(loc.fracty < 1.0 && loc.fracty >= 0);
+		}
+
+		// ˫Բֵ
+		double interpolate(const glm::vec2& pt) const
+		{
+			Location loc;
+			locate(pt, loc);
+			return interpolate(loc);
+		}
+
+		double interpolate(const Location& loc) const
+		{
+			int i0 = clampTangential(0, loc.i), i1 = clampTangential(0, loc.i + 1);
+			int j0 = clampTangential(1, loc.j) * mStrideJ, j1 = clampTangential(1, loc.j + 1) * mStrideJ;
+			const T* base = &mData[mOrigin];
+
+			double tmp1 = base[i0 + j0];
+			double tmp2 = base[i0 + j1];
+			double tmp3 = base[i1 + j0];
+			double tmp4 = base[i1 + j1];
+
+			double tmp12 = lerp(tmp1, tmp2, loc.fracty);
+			double tmp34 = lerp(tmp3, tmp4, loc.fracty);
+
+			return lerp(tmp12, tmp34, loc.fractx);
+		}
+
+		// βֵֻڵԪĵ
+		double interpolateCubic(const glm::vec2& pt) const
+		{
+			Location loc;
+			locate(pt, loc);
+			return interpolateCubic(loc);
+		}
+
+		double interpolateCubic(const Location& loc) const
+		{
+			int i = loc.i, j = loc.j;
+			double tmp1 = cubicY(i - 1 < 0 ? i : i - 1, j, loc.fracty);
+			double tmp2 = cubicY(i, j, loc.fracty);
+			double tmp3 = cubicY(i + 1, j, loc.fracty);
+			double tmp4 = cubicY(i + 2, j, loc.fracty);
+
+			return cubic(tmp1, tmp2, tmp3, tmp4, loc.fractx);
+		}
+
+		// ꣬ظõڵ
+		void getCell(const glm::vec2& pt, int& i, int& j) const
+		{
+			glm::vec2 pos = worldToSelf(pt);
+			i = (int)(pos[0] / cellSize);
+			j = (int)(pos[1] / cellSize);
+		}
+
+		void swap(Grid2d& other)
+		{
+			mData.swap(other.mData);
+			std::swap(mDfltValue, other.mDfltValue);
+		}
+
+		float cellSize;
+		int dim[2];			// Ԫ
+		glm::vec2 mMax;		// ռеĳߴ
+
+	protected:
+		static bool isFace(int axis)
+		{
+			return S == Stagger2d::FaceX + axis;
+		}
+
+		static double lerp(double a, double b, double t)
+		{
+			return (1 - t) * a + t * b;
+		}
+
+		bool inBand(int i, int j) const
+		{
+			return i >= -GHOST && i < mSamples[0] + GHOST &&
+				   j >= -GHOST && j < mSamples[1] + GHOST;
+		}
+
+		int clampTangential(int axis, int i) const
+		{
+			if (S == Stagger2d::Cell || isFace(axis))
+				return i;
+			return i < 0 ? 0 : (i > dim[axis] - 1 ? dim[axis] - 1 : i);
+		}
+
+		// ڲλڵԪĵķƽưԪ񣬲е [0, mMax] 
+		glm::vec2 worldToSelf(const glm::vec2& pt) const
+		{
+			glm::vec2 out;
+			for (int a = 0; a < 2; a++)
+			{
+				double x = isFace(a) ? pt[a] : pt[a] - cellSize * 0.5;
+				x = 0.0 > x ? 0.0 : x;
+				out[a] = x < mMax[a] ? x : mMax[a];
+			}
+			return out;
+		}
+
+		static double cubic(double q1, double q2, double q3, double q4, double t)
+		{
+			double deltaq = q3 - q2;
+			double d1 = (q3 - q1) * 0.5;
+			double d2 = (q4 - q2) * 0.5;
+
+			// ǿƵ d1/d2  deltaq Ųͬ
+			if (deltaq > 0.0001)
+			{
+				d1 = d1 > 0 ? d1 : 0.0;
+				d2 = d2 > 0 ? d2 : 0.0;
+			}
+			else if (deltaq < 0.0001)
+			{
+				d1 = d1 < 0 ? d1 : 0.0;
+				d2 = d2 < 0 ? d2 : 0.0;
+			}
+
+			return q2 + d1 * t + (3 * deltaq - 2 * d1 - d2) * t * t + (-2 * deltaq + d1 + d2) * t * t * t;
+		}
+
+		double cubicY(int i, int j, double fracty) const
+		{
+			const Grid2d& g = *this;
+			double tmp1 = g(i, j - 1 < 0 ? j : j - 1);
+			double tmp2 = g(i, j);
+			double tmp3 = g(i, j + 1);
+			double tmp4 = g(i, j + 2);
+			return cubic(tmp1, tmp2, tmp3, tmp4, fracty);
+		}
+
+		T mDfltValue;
+		int mSamples[2];	// ⵥԪĲ
+		int mOrigin;		//  (0,0) е±
+		int mStrideJ;
+		std::vector<T> mData;
+	};
+}
+
+#endif
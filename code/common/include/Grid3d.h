@@ -0,0 +1,278 @@
+#pragma once
+#ifndef __GRID_3D_H__
+#define __GRID_3D_H__
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Glb {
+
+	// Where the samples of a Grid3d sit: at cell centers, or at the centers of the
+	// faces normal to x, y or z (one more sample than cells along that axis)
+	struct Stagger3d
+	{
+		enum Type
+		{
+			Cell,
+			FaceX,
+			FaceY,
+			FaceZ
+		};
+	};
+
+	// Grid3d stores one value of type T per sample in a flat array.
+	// Columns are indexed with i and increase with x, rows with k and z, stacks
+	// with j and y, so the layout matches MACGrid3d (i fastest, then k, then j).
+	//
+	// The array is padded with GHOST layers on every side that hold the default
+	// value, so operator() is a plain index computation with no bounds checks and
+	// stencils and interpolation may read up to GHOST samples outside the grid.
+	// Writes must stay inside the grid. Along the tangential axes of a face grid
+	// interpolate() clamps to the border samples, once per lookup.
+	//
+	// World space extends from (0,0,0) to mMax; interpolate() returns the default
+	// value for points beyond the last sample.
+	template <typename T, int S = Stagger3d::Cell>
+	class Grid3d
+	{
+	public:
+		static const int GHOST = 3;
+
+		Grid3d() : cellSize(0.0f), mMax(0.0f), mDfltValue(T())
+		{
+			dim[0] = dim[1] = dim[2] = 0;
+			mOrigin = mStrideK = mStrideJ = 0;
+		}
+
+		// Resize to the samples of dimX * dimY * dimZ cells and fill with dfltValue
+		void initialize(const int cells[3], float cellSize, T dfltValue = T())
+		{
+			this->cellSize = cellSize;
+			for (int a = 0; a < 3; a++)
+			{
+				dim[a] = cells[a];
+				mSamples[a] = cells[a] + (isFace(a) ? 1 : 0);
+				mMax[a] = cellSize * mSamples[a];
+			}
+
+			int padX = mSamples[0] + 2 * GHOST;
+			int padZ = mSamples[2] + 2 * GHOST;
+			int padY = mSamples[1] + 2 * GHOST;
+			mStrideK = padX;
+			mStrideJ = padX * padZ;
+			mOrigin = GHOST + GHOST * mStrideK + GHOST * mStrideJ;
+			mData.assign(padX * padZ * padY, dfltValue);
+			mDfltValue = dfltValue;
+		}
+
+		// Refill with dfltValue, ghosts included
+		void initialize(T dfltValue)
+		{
+			mDfltValue = dfltValue;
+			std::fill(mData.begin(), mData.end(), dfltValue);
+		}
+
+		T& operator()(int i, int j, int k)
+		{
+			assert(inBand(i, j, k));
+			return mData[mOrigin + i + k * mStrideK + j * mStrideJ];
+		}
+
+		const T& operator()(int i, int j, int k) const
+		{
+			assert(inBand(i, j, k));
+			return mData[mOrigin + i + k * mStrideK + j * mStrideJ];
+		}
+
+		// The cell a world space point falls in and its fractional position inside
+		// that cell. It only depends on the stagger and the size of the grid, so one
+		// lookup serves every field sampled at the same point
+		struct Location
+		{
+			int i, j, k;
+			double fractx, fracty, fractz;
+		};
+
+		void locate(const glm::vec3& pt, Location& loc) const
+		{
+			glm::vec3 pos = worldToSelf(pt);
+
+			loc.i = (int)(pos[0] / cellSize);
+			loc.j = (int)(pos[1] / cellSize);
+			loc.k = (int)(pos[2] / cellSize);
+
+			double scale = 1.0 / cellSize;
+			loc.fractx = scale * (pos[0] - loc.i * cellSize);
+			loc.fracty = scale * (pos[1] - loc.j * cellSize);
+			loc.fractz = scale * (pos[2] - loc.k * cellSize);
+
+			assert(loc.fractx < 1.0 && loc.fractx >= 0);
+			assert(loc.fracty < 1.0 && loc.fracty >= 0);
+			assert(loc.fractz < 1.0 && loc.fractz >= 0);
+		}
+
+		// Trilinear interpolation at a point in world coordinates
+		double interpolate(const glm::vec3& pt) const
+		{
+			Location loc;
+			locate(pt, loc);
+			return interpolate(loc);
+		}
+
+		double interpolate(const Location& loc) const
+		{
+			int i0 = clampTangential(0, loc.i), i1 = clampTangential(0, loc.i + 1);
+			int j0 = clampTangential(1, loc.j) * mStrideJ, j1 = clampTangential(1, loc.j + 1) * mStrideJ;
+			int k0 = clampTangential(2, loc.k) * mStrideK, k1 = clampTangential(2, loc.k + 1) * mStrideK;
+			const T* base = &mData[mOrigin];
+
+			double tmp1 = base[i0 + j0 + k0];
+			double tmp2 = base[i0 + j1 + k0];
+			double tmp3 = base[i1 + j0 + k0];
+			double tmp4 = base[i1 + j1 + k0];
+
+			double tmp5 = base[i0 + j0 + k1];
+			double tmp6 = base[i0 + j1 + k1];
+			double tmp7 = base[i1 + j0 + k1];
+			double tmp8 = base[i1 + j1 + k1];
+
+			double tmp12 = lerp(tmp1, tmp2, loc.fracty);
+			double tmp34 = lerp(tmp3, tmp4, loc.fracty);
+
+			double tmp56 = lerp(tmp5, tmp6, loc.fracty);
+			double tmp78 = lerp(tmp7, tmp8, loc.fracty);
+
+			double tmp1234 = lerp(tmp12, tmp34, loc.fractx);
+			double tmp5678 = lerp(tmp56, tmp78, loc.fractx);
+
+			return lerp(tmp1234, tmp5678, loc.fractz);
+		}
+
+		// Monotonic cubic interpolation at a point in world coordinates, cell grids only
+		double interpolateCubic(const glm::vec3& pt) const
+		{
+			Location loc;
+			locate(pt, loc);
+			return interpolateCubic(loc);
+		}
+
+		double interpolateCubic(const Location& loc) const
+		{
+			int i = loc.i, j = loc.j, k = loc.k;
+			double tmp1 = cubicX(i, j, k - 1 < 0 ? k : k - 1, loc.fracty, loc.fractx);
+			double tmp2 = cubicX(i, j, k, loc.fracty, loc.fractx);
+			double tmp3 = cubicX(i, j, k + 1, loc.fracty, loc.fractx);
+			double tmp4 = cubicX(i, j, k + 2, loc.fracty, loc.fractx);
+
+			return cubic(tmp1, tmp2, tmp3, tmp4, loc.fractz);
+		}
+
+		// Given a point in world coordinates, return the cell index (i,j,k) corresponding to it
+		void getCell(const glm::vec3& pt, int& i, int& j, int& k) const
+		{
+			glm::vec3 pos = worldToSelf(pt);
+			i = (int)(pos[0] / cellSize);
+			j = (int)(pos[1] / cellSize);
+			k = (int)(pos[2] / cellSize);
+		}
+
+		void swap(Grid3d& other)
+		{
+			mData.swap(other.mData);
+			std::swap(mDfltValue, other.mDfltValue);
+		}
+
+		float cellSize;
+		int dim[3];			// number of cells
+		glm::vec3 mMax;		// world space size of the sampled region
+
+	protected:
+		static bool isFace(int axis)
+		{
+			return S == Stagger3d::FaceX + axis;
+		}
+
+		static double lerp(double a, double b, double t)
+		{
+			return (1 - t) * a + t * b;
+		}
+
+		bool inBand(int i, int j, int k) const
+		{
+			return i >= -GHOST && i < mSamples[0] + GHOST &&
+				   j >= -GHOST && j < mSamples[1] + GHOST &&
+				   k >= -GHOST && k < mSamples[2] + GHOST;
+		}
+
+		int clampTangential(int axis, int i) const
+		{
+			if (S == Stagger3d::Cell || isFace(axis))
+				return i;
+			return i < 0 ? 0 : (i > dim[axis] - 1 ? dim[axis] - 1 : i);
+		}
+
+		// Shift by half a cell on the axes the samples are centered on and clamp to [0, mMax]
+		glm::vec3 worldToSelf(const glm::vec3& pt) const
+		{
+			glm::vec3 out;
+			for (int a = 0; a < 3; a++)
+			{
+				double x = isFace(a) ? pt[a] : pt[a] - cellSize * 0.5;
+				x = 0.0 > x ? 0.0 : x;
+				out[a] = x < mMax[a] ? x : mMax[a];
+			}
+			return out;
+		}
+
+		static double cubic(double q1, double q2, double q3, double q4, double t)
+		{
+			double deltaq = q3 - q2;
+			double d1 = (q3 - q1) * 0.5;
+			double d2 = (q4 - q2) * 0.5;
+
+			// Force monotonic: if d1/d2 differ in sign to deltaq, make it zero
+			if (deltaq > 0.0001)
+			{
+				d1 = d1 > 0 ? d1 : 0.0;
+				d2 = d2 > 0 ? d2 : 0.0;
+			}
+			else if (deltaq < 0.0001)
+			{
+				d1 = d1 < 0 ? d1 : 0.0;
+				d2 = d2 < 0 ? d2 : 0.0;
+			}
+
+			return q2 + d1 * t + (3 * deltaq - 2 * d1 - d2) * t * t + (-2 * deltaq + d1 + d2) * t * t * t;
+		}
+
+		double cubicY(int i, int j, int k, double fracty) const
+		{
+			const Grid3d& g = *this;
+			double tmp1 = g(i, j - 1 < 0 ? j : j - 1, k);
+			double tmp2 = g(i, j, k);
+			double tmp3 = g(i, j + 1, k);
+			double tmp4 = g(i, j + 2, k);
+			return cubic(tmp1, tmp2, tmp3, tmp4, fracty);
+		}
+
+		double cubicX(int i, int j, int k, double fracty, double fractx) const
+		{
+			double tmp1 = cubicY(i - 1 < 0 ? i : i - 1, j, k, fracty);
+			double tmp2 = cubicY(i, j, k, fracty);
+			double tmp3 = cubicY(i + 1, j, k, fracty);
+			double tmp4 = cubicY(i + 2, j, k, fracty);
+			return cubic(tmp1, tmp2, tmp3, tmp4, fractx);
+		}
+
+		T mDfltValue;
+		int mSamples[3];	// samples per axis without ghosts
+		int mOrigin;		// array index of sample (0,0,0)
+		int mStrideK;
+		int mStrideJ;
+		std::vector<T> mData;
+	};
+}
+
+#endif
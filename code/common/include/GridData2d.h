@@ -1,91 +0,0 @@
-#pragma once
-#ifndef __GRID_DATA_2D_H__
-#define __GRID_DATA_2D_H__
-
-#pragma warning(disable: 4244 4267 4996)
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/io.hpp>
-#include <glm/glm.hpp>
-
-namespace Glb {
-
-	using namespace boost::numeric;
-
-	// GridData2d ܹ洢еκ
-	//  i  x Ӷ
-	//  j  y Ӷ
-	//
-	// GridData2d ͨȫֱ theDim2d  theCellSize2d гʼ
-	// theDim2d ÿXYZϵĵԪ
-	// GridData2d ռߴ(0,0)쵽 mMax
-	//  mMax  ( theCellSize * theDim[0], theCellSize * theDim[1])
-	class GridData2d
-	{
-	public:
-		GridData2d();
-		GridData2d(const GridData2d& orig);
-		virtual ~GridData2d();
-		virtual GridData2d& operator=(const GridData2d& orig);
-
-		// Ĭֵʼ
-		virtual void initialize(double dfltValue = 0.0);
-
-		// أijλϵĿɸ
-		// ʹ GridData2d(i, j) = num иֵ
-		virtual double& operator()(int i, int j);
-
-		// ꣬زֵõֵ
-		// ڳΧĵ㣬Ĭֵ
-		virtual double interpolate(const glm::vec2& pt);	// ֵݸ귵
-
-		// ݣ mDataͨںublasв
-		ublas::vector<double>& data();
-
-		// ꣬ظõڵ
-		virtual void getCell(const glm::vec2& pt, int& i, int& j);
-
-		virtual glm::vec2 worldToSelf(const glm::vec2& pt) const;
-		double mDfltValue;				// Ĭֵڳʼ
-		glm::vec2 mMax;					// άռе꣬ʾĳߴ
-		ublas::vector<double> mData;	// 洢ݵһά
-		float cellSize;
-		int dim[2];
-	};
-
-	class GridData2dX : public GridData2d
-	{
-	public:
-		GridData2dX();
-		virtual ~GridData2dX();
-		virtual void initialize(double dfltValue = 0.0);
-		virtual double& operator()(int i, int j);
-		virtual glm::vec2 worldToSelf(const glm::vec2& pt) const;
-	};
-
-	class GridData2dY : public GridData2d
-	{
-	public:
-		GridData2dY();
-		virtual ~GridData2dY();
-		virtual void initialize(double dfltValue = 0.0);
-		virtual double& operator()(int i, int j);
-		virtual glm::vec2 worldToSelf(const glm::vec2& pt) const;
-	};
-
-	class CubicGridData2d : public GridData2d
-	{
-	public:
-		CubicGridData2d();
-		CubicGridData2d(const CubicGridData2d& orig);
-		virtual ~CubicGridData2d();
-		virtual double interpolate(const glm::vec2& pt);
-
-	protected:
-
-		double cubic(double q1, double q2, double q3, double q4, double t);
-		double interpX(int i, int j, double fracty, double fractx);
-		double interpY(int i, int j, double fracty);
-	};
-}
-
-#endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef __MULTIGRID_2D_H__
+#define __MULTIGRID_2D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "PoissonStencil2d.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// Multigrid2d ѹɷ̵ļζ V-cycle
+	// ÿһڸϽԪ룬ֻҪһӵԪ壬ֵԪ
+	// ӶӵԪͣӰѴֵƵÿӵԪ
+	// ӰȨֵԪ֮ȨΪϸ-Ȩ֮͵һ룬
+	// Ƭص Galerkin  R * A * P һ롣ûйʱɢģͬ
+	// йʱȨΪ 0ϸĹڴϲᱻĨ
+	// ⻬Ϊ Gauss-Seidel෴˳ִУ V-cycle ǶԳƵģΪ CG Ԥ
+	// ޣֵԪϸʱذ巽⻬ڰڴ޷ʾ
+	// ϸʱ V-cycle ʱӦΪ CG ԤʹãCG Щģ̬
+	class Multigrid2d
+	{
+	public:
+		Multigrid2d();
+		~Multigrid2d();
+
+		// ϸģ彨㣬仯Ҫµ
+		void build(const PoissonStencil2d& A);
+
+		// z = M^-1 * rֵһ V-cycle
+		void precondition(const ublas::vector<double>& r, ublas::vector<double>& z);
+
+		// ִ V-cycleֱ b - A * x Ķ tol
+		// x Ϊֵõ V-cycle ղвmax_cycles δʱ false
+		bool solve(const ublas::vector<double>& b, ublas::vector<double>& x, int max_cycles, double tol, int& cycles, double& residual);
+
+		int numLevels() const;
+
+		int preSweeps;
+		int postSweeps;
+		int coarseSweeps;
+
+	protected:
+		void vcycle(int level);
+		void relax(int level, int color);
+		void residual(int level);
+		void restrictResidual(int level);
+		void prolongateCorrection(int level);
+
+		// (i,j)  (i+1,j)(i,j+1) ֮Ȩأ 0 ǵõΪ 0
+		double weightX(int level, int i, int j) const;
+		double weightY(int level, int i, int j) const;
+
+		std::vector<PoissonStencil2d> mA;				// ÿһǣ 0 㼴ϸģ
+		std::vector<std::vector<double>> mWeightX;		//  1 ȨأԪ
+		std::vector<std::vector<double>> mWeightY;
+		std::vector<std::vector<double>> mDiag;			//  1 ĶԽԪĸȨ֮
+		std::vector<ublas::vector<double>> mX;
+		std::vector<ublas::vector<double>> mB;
+		std::vector<ublas::vector<double>> mR;
+	};
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef __MULTIGRID_3D_H__
+#define __MULTIGRID_3D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "PoissonStencil3d.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// Multigrid3d is a geometric multigrid V-cycle for the pressure Poisson problem.
+	// Every level halves the cells in each direction; a coarse cell is fluid if any
+	// of its children is. Restriction sums the children and prolongation copies the
+	// coarse value back to every fluid child.
+	// The coarse operator has one weight per face: half the summed weights of the
+	// fine fluid-fluid faces that cross it, i.e. half the Galerkin operator R * A * P
+	// of the piecewise constant transfer. Without solids this is the fine stencil
+	// scaled by 2 per level; faces blocked by solids get less or nothing, so thin
+	// solids are not erased on the coarse levels.
+	// The smoother is red-black Gauss-Seidel, run in reverse order after the coarse
+	// correction, so one V-cycle is a symmetric operator and can precondition CG.
+	// Limitation: a coarse cell spanning both sides of a thin solid cannot represent
+	// an error that jumps across the solid and is smooth along it, so plain V-cycles
+	// may converge slowly with thin solids. Use it as a CG preconditioner there; CG
+	// removes those few modes.
+	class Multigrid3d
+	{
+	public:
+		Multigrid3d();
+		~Multigrid3d();
+
+		// Build the level hierarchy from the fine stencil, again whenever solids change
+		void build(const PoissonStencil3d& A);
+
+		// z = M^-1 * r, one V-cycle from a zero initial guess
+		void precondition(const ublas::vector<double>& r, ublas::vector<double>& z);
+
+		// Standalone solver: V-cycles until the 2-norm of b - A * x goes below tol.
+		// x is the initial guess. Returns the cycles used and the final residual norm,
+		// and false if max_cycles were not enough.
+		bool solve(const ublas::vector<double>& b, ublas::vector<double>& x, int max_cycles, double tol, int& cycles, double& residual);
+
+		int numLevels() const;
+
+		int preSweeps;
+		int postSweeps;
+		int coarseSweeps;
+
+	protected:
+		void vcycle(int level);
+		void relax(int level, int color);
+		void residual(int level);
+		void restrictResidual(int level);
+		void prolongateCorrection(int level);
+
+		// weight of the face between (i,j,k) and its +x, +y or +z neighbour; from the
+		// fluid flags on level 0, 0 for faces outside the grid
+		double weight(int level, int axis, int i, int j, int k) const;
+
+		std::vector<PoissonStencil3d> mA;				// fluid flags of every level, level 0 is the fine stencil
+		std::vector<std::vector<double>> mWeight[3];	// face weights per axis from level 1 on, by cell index
+		std::vector<std::vector<double>> mDiag;			// diagonal from level 1 on, the sum of the six face weights
+		std::vector<ublas::vector<double>> mX;
+		std::vector<ublas::vector<double>> mB;
+		std::vector<ublas::vector<double>> mR;
+	};
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef __POISSON_STENCIL_2D_H__
+#define __POISSON_STENCIL_2D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// PoissonStencil2d ڲ洢ѹɾ
+	// Ԫ MACGrid2d ͬ (i + j * dimX)
+	// ÿԪֻһֽڵǣΧһȦ ghost Ԫ
+	// 5˹Ӽʱ㣺ԽԪΪھӸÿھӹ -1
+	class PoissonStencil2d
+	{
+	public:
+		PoissonStencil2d();
+		~PoissonStencil2d();
+
+		// Ϊ dimX * dimY ԪȫΪ
+		void resize(int dimX, int dimY);
+
+		//  (i,j) Ϊ壬Ƿ仯ʱ true
+		bool setFluid(int i, int j, bool fluid);
+		bool isFluid(int i, int j) const;
+
+		// ӿڣʹģװõľ
+		unsigned int size1() const;
+		double operator()(int row, int col) const;
+
+		// y = A * x
+		void apply(const ublas::vector<double>& x, ublas::vector<double>& y) const;
+
+		// y = A * xͬһѭз inner_prod(x, y)
+		double applyAndDot(const ublas::vector<double>& x, ublas::vector<double>& y) const;
+
+		// r = b - scale * A * x嵥ԪΪ 0
+		void residual(const ublas::vector<double>& b, const ublas::vector<double>& x, ublas::vector<double>& r, double scale) const;
+
+		//  (i + j) % 2 == color ĵԪһ scale * A * x = b  Gauss-Seidel 
+		void relax(const ublas::vector<double>& b, ublas::vector<double>& x, double scale, int color) const;
+
+		int dim[2];
+
+	protected:
+		friend class Preconditioner2d;
+
+		int padded(int i, int j) const;
+
+		int strideJ;	// е
+		std::vector<unsigned char> mFluid;
+	};
+}
+
+#endif
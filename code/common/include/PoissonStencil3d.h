@@ -0,0 +1,60 @@
+#pragma once
+#ifndef __POISSON_STENCIL_3D_H__
+#define __POISSON_STENCIL_3D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// PoissonStencil3d is the pressure matrix of a MAC grid applied without storing it.
+	// Cells use the same linear index as MACGrid3d (i + k * dimX + j * dimX * dimZ).
+	// Only one flag byte per cell is kept, padded with a layer of solid ghost cells,
+	// and the 7-point Laplacian is evaluated on the fly: the diagonal is the number
+	// of fluid neighbours and every fluid neighbour contributes -1.
+	class PoissonStencil3d
+	{
+	public:
+		PoissonStencil3d();
+		~PoissonStencil3d();
+
+		// Resize to dimX * dimY * dimZ cells, all of them solid
+		void resize(int dimX, int dimY, int dimZ);
+
+		// Mark cell (i,j,k) as fluid or solid, returns true if the flag changed
+		bool setFluid(int i, int j, int k, bool fluid);
+		bool isFluid(int i, int j, int k) const;
+
+		// Matrix-like access, so the stencil can stand in for the assembled matrix
+		unsigned int size1() const;
+		double operator()(int row, int col) const;
+
+		// y = A * x
+		void apply(const ublas::vector<double>& x, ublas::vector<double>& y) const;
+
+		// y = A * x, returns inner_prod(x, y) computed in the same pass
+		double applyAndDot(const ublas::vector<double>& x, ublas::vector<double>& y) const;
+
+		// r = b - scale * A * x, zero in solid cells
+		void residual(const ublas::vector<double>& b, const ublas::vector<double>& x, ublas::vector<double>& r, double scale) const;
+
+		// One Gauss-Seidel sweep of scale * A * x = b over the cells with (i + j + k) % 2 == color
+		void relax(const ublas::vector<double>& b, ublas::vector<double>& x, double scale, int color) const;
+
+		int dim[3];
+
+	protected:
+		friend class Preconditioner3d;
+
+		int padded(int i, int j, int k) const;
+
+		int strideK;	// padded index offset between neighbouring rows
+		int strideJ;	// padded index offset between neighbouring stacks
+		std::vector<unsigned char> mFluid;
+	};
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef __PRECONDITIONER_2D_H__
+#define __PRECONDITIONER_2D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "PoissonStencil2d.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// Preconditioner2d Ϊѹģϵ CG  z = M^-1 * r
+	//   IC0:               Ԫ˳Ĳȫ Choleskyǰشһ˳ɨ
+	//   Jacobi:            z = r / diag(A)
+	//   IncompletePoisson: M^-1 = K * K^TK = I - L * D^-1ɲеģ
+	//   RedBlackMIC0:      ɫԪǰȫ Choleskyÿһֻһɫɲ
+	class Preconditioner2d
+	{
+	public:
+		enum Type
+		{
+			IC0,
+			Jacobi,
+			IncompletePoisson,
+			RedBlackMIC0
+		};
+
+		Preconditioner2d();
+		~Preconditioner2d();
+
+		//  A 嵥Ԫֽ⣬仯Ҫµ
+		void build(const PoissonStencil2d& A, int type);
+
+		// z = M^-1 * r
+		void apply(const ublas::vector<double>& r, ublas::vector<double>& z);
+
+		int type;
+
+	protected:
+		void buildIC0();
+		void buildRedBlackMIC0();
+		void applyIC0(const double* r, double* z);
+		void applyJacobi(const double* r, double* z);
+		void applyIncompletePoisson(const double* r, double* z);
+		void applyRedBlackMIC0(const double* r, double* z);
+
+		const PoissonStencil2d* mA;
+		std::vector<double> mPrecon; // Cholesky Ϊ 1 / sqrt(Ԫ)Ϊ 1 / diag
+		std::vector<double> mTemp;
+	};
+}
+
+#endif
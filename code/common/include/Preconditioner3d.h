@@ -0,0 +1,57 @@
+#pragma once
+#ifndef __PRECONDITIONER_3D_H__
+#define __PRECONDITIONER_3D_H__
+
+#pragma warning(disable: 4244 4267 4996)
+#include <boost/numeric/ublas/vector.hpp>
+#include <vector>
+
+#include "PoissonStencil3d.h"
+
+namespace Glb {
+
+	using namespace boost::numeric;
+
+	// Preconditioner3d applies z = M^-1 * r for CG on the pressure stencil.
+	//   IC0:               incomplete Cholesky in cell order, one sequential sweep each way
+	//   Jacobi:            z = r / diag(A)
+	//   IncompletePoisson: M^-1 = K * K^T with K = I - L * D^-1, two parallel stencil passes
+	//   RedBlackMIC0:      modified incomplete Cholesky with red cells ordered first,
+	//                      so every sweep runs over one color at a time in parallel
+	class Preconditioner3d
+	{
+	public:
+		enum Type
+		{
+			IC0,
+			Jacobi,
+			IncompletePoisson,
+			RedBlackMIC0
+		};
+
+		Preconditioner3d();
+		~Preconditioner3d();
+
+		// Factorize for the fluid cells of A, again whenever solids change
+		void build(const PoissonStencil3d& A, int type);
+
+		// z = M^-1 * r
+		void apply(const ublas::vector<double>& r, ublas::vector<double>& z);
+
+		int type;
+
+	protected:
+		void buildIC0();
+		void buildRedBlackMIC0();
+		void applyIC0(const double* r, double* z);
+		void applyJacobi(const double* r, double* z);
+		void applyIncompletePoisson(const double* r, double* z);
+		void applyRedBlackMIC0(const double* r, double* z);
+
+		const PoissonStencil3d* mA;
+		std::vector<double> mPrecon; // 1 / sqrt(pivot) for the Cholesky variants, 1 / diag otherwise
+		std::vector<double> mTemp;
+	};
+}
+
+#endif
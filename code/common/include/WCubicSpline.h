@@ -6,28 +6,67 @@
 #include <vector>
 
 namespace Glb {
+    // The 2D cubic spline for h = 1 sampled at q = r / h = i / SIZE, i = 0..SIZE, as
+    // interleaved (value, gradient factor) pairs. The gradient factor is dW/dr / r, so
+    // grad W = factor * r, and stays finite at q = 0. The entry at q = 1 is zero, so
+    // interpolating between i and i + 1 never reads past the table. Built at compile time
+    struct WCubicSplineTable2d {
+        static const int SIZE = 128;
+
+        constexpr WCubicSplineTable2d() : data{} {
+            for (int i = 0; i <= SIZE; i++) {
+                float q = (float)i / SIZE;
+                data[i][0] = Value(q);
+                data[i][1] = GradFactor(q);
+            }
+        }
+
+        static constexpr float Value(float q) {
+            return q < 0.5f ? SIGMA * (6.0f * (q * q * q - q * q) + 1.0f)
+                 : q < 1.0f ? SIGMA * 2.0f * (1.0f - q) * (1.0f - q) * (1.0f - q)
+                 : 0.0f;
+        }
+
+        static constexpr float GradFactor(float q) {
+            return q < 0.5f ? SIGMA * 6.0f * (3.0f * q - 2.0f)
+                 : q < 1.0f ? -SIGMA * 6.0f * (1.0f - q) * (1.0f - q) / q
+                 : 0.0f;
+        }
+
+        static constexpr float SIGMA = 40.0f / (7.0f * 3.14159265f);
+
+        float data[SIZE + 1][2];
+    };
+
+    // WCubicSpline2d scales the shared table to the support radius h: the value by
+    // 1 / h^2 and the gradient factor by 1 / h^4. Lookups interpolate linearly between
+    // the two nearest samples, or take the nearest one
     class WCubicSpline2d {
     public:
         WCubicSpline2d() = delete;
-        explicit WCubicSpline2d(float h);
+        explicit WCubicSpline2d(float h, bool interpolate = true);
         ~WCubicSpline2d();
 
         float Value(float distance);
 
         glm::vec2 Grad(glm::vec2 radius);
-        
-    private:
-        float CalculateValue(float distance);
 
-        glm::vec2 CalculateGrad(glm::vec2 radius);
+        // distance is |radius|, for callers that have it already
+        glm::vec2 Grad(glm::vec2 radius, float distance);
+
+        // (value, gradient factor) at a distance, 0 beyond h
+        glm::vec2 ValueAndGradFactor(float distance);
+
+        float GetH();
+        bool GetInterpolate();
 
     private:
         float mH;
-        float mH2;
-        float mSigma;
-        glm::uvec2 mBufferSize;
-        std::vector<std::vector<glm::vec2>> mGradBuffer;
-        std::vector<float> mValueBuffer;
+        float mTableScale;  // SIZE / h
+        float mValueScale;  // 1 / h^2
+        float mGradScale;   // 1 / h^4
+        bool mInterpolate;
+        static constexpr WCubicSplineTable2d sTable = WCubicSplineTable2d();
     };
 
     class WCubicSpline3d {
@@ -26,6 +26,19 @@ namespace Eulerian2dPara
     float boussinesqAlpha = 500.0;
     float boussinesqBeta = 2500.0;
     float vorticityConst = 100.0;
+
+    // pressure solver: 0 = PCG, 1 = multigrid (V-cycles, finished by MG-PCG if they stall on thin solids),
+    // 2 = multigrid-preconditioned CG, 3 = DCT direct solve when there are no interior solids, MG-PCG otherwise
+    int pressureSolver = 2;
+    // PCG preconditioner: 0 = IC(0), 1 = Jacobi, 2 = incomplete Poisson, 3 = red-black MIC(0)
+    int preconditioner = 0;
+    // convergence threshold on the residual 2-norm, relative to the norm of b if relativeTolerance is set
+    float pressureTolerance = 0.005f;
+    bool relativeTolerance = false;
+    // iterations (V-cycles for multigrid), residual and wall time (ms) of the last projection
+    int pressureIterations = 0;
+    float pressureResidual = 0.0f;
+    float pressureTime = 0.0f;
 }
 
 namespace Eulerian3dPara
@@ -61,11 +74,28 @@ namespace Eulerian3dPara
     float boussinesqBeta = 2500.0;
     float vorticityConst = 100.0;
 
+    // pressure solver: 0 = PCG, 1 = multigrid (V-cycles, finished by MG-PCG if they stall on thin solids),
+    // 2 = multigrid-preconditioned CG, 3 = DCT direct solve when there are no interior solids, MG-PCG otherwise
+    int pressureSolver = 2;
+    // PCG preconditioner: 0 = IC(0), 1 = Jacobi, 2 = incomplete Poisson, 3 = red-black MIC(0)
+    int preconditioner = 0;
+    // convergence threshold on the residual 2-norm, relative to the norm of b if relativeTolerance is set
+    float pressureTolerance = 0.005f;
+    bool relativeTolerance = false;
+    // iterations (V-cycles for multigrid), residual and wall time (ms) of the last projection
+    int pressureIterations = 0;
+    float pressureResidual = 0.0f;
+    float pressureTime = 0.0f;
+
 }
 
 namespace Lagrangian2dPara
 {
     float scale = 2;
+
+    // seed of the jitter of the particles placed by addFluidBlock, the same seed gives the same scene
+    unsigned int seed = 0;
+
     float dt = 0.0016;
     int substep = 1;
     float maxVelocity = 100;
@@ -81,11 +111,62 @@ namespace Lagrangian2dPara
     float stiffness = 70.0f;
     float exponent = 7.0f;
     float viscosity = 0.03f;
+
+    // threads of the per-particle solver loops, 0 = one per core
+    int threads = 0;
+
+    // set from the inspector, the next neighbour grid build times the block sorts and logs them
+    bool benchmarkBlockSort = false;
+
+    // reuse Verlet neighbour lists across substeps, the candidates are searched
+    // within (1 + neighborSkin) * supportRadius and the lists are rebuilt once a
+    // particle has moved more than half the skin
+    bool neighborList = false;
+    float neighborSkin = 0.3f;
+
+    // interpolate the kernel table linearly between samples, otherwise take the nearest one
+    bool kernelInterpolation = true;
+
+    // record the pairs the density pass finds on the grid and replay them in the force
+    // pass instead of walking the grid a second time, without neighbour lists only
+    bool pairStream = false;
+
+    // adaptive time stepping: each frame advances frameTime in steps chosen from the
+    // CFL number, the largest acceleration and the viscosity, clamped to [minDt, maxDt].
+    // dt and substep are only used when it is off
+    bool adaptiveTimeStep = false;
+    float frameTime = 0.0032f;
+    float cflNumber = 0.4f;
+    float minDt = 1e-5f;
+    float maxDt = 0.004f;
+
+    // dt the criteria allowed in the last step and steps the last frame took
+    float stepDt = 0.0f;
+    int frameSteps = 0;
+
+    // emitters and sinks: when emitters is on, the scene gets a nozzle that shoots
+    // particles in and a box that removes the particles entering it. The particle
+    // arrays are reserved for maxParticleNum particles when the scene is built and
+    // the nozzle pauses while the pool is full instead of growing them
+    bool emitters = false;
+    int maxParticleNum = 20000;
+
+    // particles alive after the last frame, the milliseconds the emitters and sinks
+    // took in it, and the particle count of the last PARTICLE_NUM_HISTORY frames as a
+    // ring buffer whose oldest entry is at particleNumHistoryOffset
+    int particleNum = 0;
+    float emissionTime = 0.0f;
+    float particleNumHistory[PARTICLE_NUM_HISTORY] = {};
+    int particleNumHistoryOffset = 0;
 }
 
 namespace Lagrangian3dPara
 {
     float scale = 1;
+
+    // seed of the jitter of the particles placed by addFluidBlock, the same seed gives the same scene
+    unsigned int seed = 0;
+
     float dt = 0.002;
     int substep = 1;
     float maxVelocity = 100;
@@ -105,6 +186,96 @@ namespace Lagrangian3dPara
     float exponent = 7.0f;
     float viscosity = 8e-5f;
 
+    // threads of the per-particle solver loops, 0 = one per core
+    int threads = 0;
+
+    // set from the inspector, the next neighbour grid build times the block sorts and logs them
+    bool benchmarkBlockSort = false;
+
+    // reuse Verlet neighbour lists across substeps, the candidates are searched
+    // within (1 + neighborSkin) * supportRadius and the lists are rebuilt once a
+    // particle has moved more than half the skin
+    bool neighborList = false;
+    float neighborSkin = 0.3f;
+
+    // numbering of the neighbour grid blocks, 0 = row-major, 1 = Morton (Z-order)
+    int blockOrder = 0;
+
+    // hash the occupied cells of the neighbour grid into a table sized by the particle
+    // count instead of allocating every block of the container
+    bool sparseGrid = false;
+
+    // widest instruction set of the grid pair loops, 0 = scalar, 1 = AVX2, 2 = AVX-512;
+    // the solver falls back to what the CPU supports. A block holds few enough particles
+    // that 16 lanes are rarely full, so AVX-512 is no faster than AVX2 by default
+    int simd = 1;
+
+    // record the pairs the density pass finds on the grid and replay them in the force
+    // pass instead of walking the grid a second time, without neighbour lists only
+    bool pairStream = false;
+
+    // adaptive time stepping: each frame advances frameTime in steps chosen from the
+    // CFL number, the largest acceleration and the viscosity, clamped to [minDt, maxDt].
+    // dt and substep are only used when it is off
+    bool adaptiveTimeStep = false;
+    float frameTime = 0.004f;
+    float cflNumber = 0.4f;
+    float minDt = 1e-5f;
+    float maxDt = 0.005f;
+
+    // dt the criteria allowed in the last step and steps the last frame took
+    float stepDt = 0.0f;
+    int frameSteps = 0;
+
+    // pressure solver: 0 = equation of state (stiffness, exponent), 1 = DFSPH, which
+    // iterates until the mean compression and the mean density change per step are
+    // below the tolerances
+    int pressureSolver = 0;
+    float densityTolerance = 0.001f;
+    float divergenceTolerance = 0.001f;
+    int maxPressureIterations = 100;
+
+    // iterations of the two DFSPH solves and the compression left in the last step
+    int densityIterations = 0;
+    int divergenceIterations = 0;
+    float densityError = 0.0f;
+
+    // set from the inspector, the next step simulates BENCHMARK_TIME of the initial scene
+    // (Lagrangian3dComponent::benchmarkPressureSolvers) with each pressure solver and logs the times
+    bool benchmarkPressureSolver = false;
+
+    // emitters and sinks: when emitters is on, the scene gets a nozzle that shoots
+    // particles in and a box that removes the particles entering it. The particle
+    // arrays are reserved for maxParticleNum particles when the scene is built and
+    // the nozzle pauses while the pool is full instead of growing them
+    bool emitters = false;
+    int maxParticleNum = 60000;
+
+    // particles alive after the last frame, the milliseconds the emitters and sinks
+    // took in it, and the particle count of the last PARTICLE_NUM_HISTORY frames as a
+    // ring buffer whose oldest entry is at particleNumHistoryOffset
+    int particleNum = 0;
+    float emissionTime = 0.0f;
+    float particleNumHistory[PARTICLE_NUM_HISTORY] = {};
+    int particleNumHistoryOffset = 0;
+
+    // sleeping blocks: a neighbour grid block whose particles, and those of the blocks
+    // around it, have stayed below sleepVelocity and sleepAccleration for sleepSteps
+    // steps goes to sleep until a particle in or next to the block exceeds the thresholds
+    // again. Its particles are frozen: velocity and acceleration are held at zero, so
+    // they do not move, and they keep the density and pressure they fell asleep with.
+    // Only their contribution to awake neighbours is still evaluated; the forces the
+    // awake neighbours exert on them are dropped. Equation of state only.
+    // The particles resting on the container walls are held there by the boundary
+    // clamp, not by pressure, and keep up to about 5 g of acceleration, which the
+    // acceleration threshold has to stay above
+    bool sleepingBlocks = false;
+    float sleepVelocity = 0.05f;
+    float sleepAccleration = 80.0f;
+    int sleepSteps = 50;
+
+    // fraction of the particles awake in the last step
+    float activeFraction = 1.0f;
 }
 
 // store system's all simulation method components
@@ -0,0 +1,82 @@
+#include "ConjGradKernels.h"
+
+#include <vector>
+
+namespace Glb
+{
+
+    static int numBlocks(int n)
+    {
+        return (n + CG_REDUCTION_BLOCK - 1) / CG_REDUCTION_BLOCK;
+    }
+
+    double cg_sum(const double *partial, int count)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < count; i++)
+            sum += partial[i];
+        return sum;
+    }
+
+    double cg_dot(const ublas::vector<double> &x, const ublas::vector<double> &y)
+    {
+        const double *xd = x.data().begin();
+        const double *yd = y.data().begin();
+        int n = x.size();
+        int blocks = numBlocks(n);
+        std::vector<double> partial(blocks);
+
+#pragma omp parallel for if (blocks > 1)
+        for (int blk = 0; blk < blocks; blk++)
+        {
+            int begin = blk * CG_REDUCTION_BLOCK;
+            int end = begin + CG_REDUCTION_BLOCK < n ? begin + CG_REDUCTION_BLOCK : n;
+            double sum = 0.0;
+            for (int i = begin; i < end; i++)
+                sum += xd[i] * yd[i];
+            partial[blk] = sum;
+        }
+
+        return cg_sum(partial.data(), blocks);
+    }
+
+    double cg_update(double alpha, const ublas::vector<double> &s, const ublas::vector<double> &z, ublas::vector<double> &p, ublas::vector<double> &r)
+    {
+        const double *sd = s.data().begin();
+        const double *zd = z.data().begin();
+        double *pd = p.data().begin();
+        double *rd = r.data().begin();
+        int n = p.size();
+        int blocks = numBlocks(n);
+        std::vector<double> partial(blocks);
+
+#pragma omp parallel for if (blocks > 1)
+        for (int blk = 0; blk < blocks; blk++)
+        {
+            int begin = blk * CG_REDUCTION_BLOCK;
+            int end = begin + CG_REDUCTION_BLOCK < n ? begin + CG_REDUCTION_BLOCK : n;
+            double sum = 0.0;
+            for (int i = begin; i < end; i++)
+            {
+                pd[i] += alpha * sd[i];
+                double ri = rd[i] - alpha * zd[i];
+                rd[i] = ri;
+                sum += ri * ri;
+            }
+            partial[blk] = sum;
+        }
+
+        return cg_sum(partial.data(), blocks);
+    }
+
+    void cg_xpby(const ublas::vector<double> &z, double beta, ublas::vector<double> &s)
+    {
+        const double *zd = z.data().begin();
+        double *sd = s.data().begin();
+        int n = s.size();
+
+#pragma omp parallel for if (n > CG_REDUCTION_BLOCK)
+        for (int i = 0; i < n; i++)
+            sd[i] = zd[i] + beta * sd[i];
+    }
+}
@@ -0,0 +1,96 @@
+#include "CountingSort.h"
+
+#include <omp.h>
+
+namespace Glb
+{
+
+    // fewest keys worth a chunk of their own, below that the histograms cost more than the sort
+    static const int MIN_CHUNK_SIZE = 4096;
+
+    CountingSort::CountingSort()
+    {
+    }
+
+    CountingSort::~CountingSort()
+    {
+    }
+
+    void CountingSort::sort(const std::vector<uint32_t> &keys, int numKeys, int threads,
+                            std::vector<uint32_t> &order, std::vector<glm::uvec2> &extents)
+    {
+        int n = keys.size();
+        int buckets = numKeys + 1; // the last bucket collects the keys out of range
+        int chunks = threads > 0 ? threads : omp_get_max_threads();
+        if (chunks > n / MIN_CHUNK_SIZE)
+            chunks = n / MIN_CHUNK_SIZE;
+        if (chunks < 1)
+            chunks = 1;
+
+        order.resize(n);
+        extents.resize(numKeys);
+        mCounts.assign(chunks * buckets, 0);
+        mTotals.resize(buckets);
+
+        // 1. histogram of every chunk
+#pragma omp parallel for num_threads(chunks) if (chunks > 1)
+        for (int c = 0; c < chunks; c++)
+        {
+            uint32_t *count = &mCounts[c * buckets];
+            int begin = (long long)n * c / chunks;
+            int end = (long long)n * (c + 1) / chunks;
+            for (int i = begin; i < end; i++)
+            {
+                uint32_t b = keys[i] < (uint32_t)numKeys ? keys[i] : numKeys;
+                count[b]++;
+            }
+        }
+
+        // 2. keys per bucket, then the first slot of every bucket
+#pragma omp parallel for num_threads(chunks) if (chunks > 1)
+        for (int b = 0; b < buckets; b++)
+        {
+            uint32_t total = 0;
+            for (int c = 0; c < chunks; c++)
+                total += mCounts[c * buckets + b];
+            mTotals[b] = total;
+        }
+
+        uint32_t slot = 0;
+        for (int b = 0; b < buckets; b++)
+        {
+            uint32_t total = mTotals[b];
+            mTotals[b] = slot;
+            slot += total;
+        }
+
+        // the chunks of a bucket follow each other in chunk order
+#pragma omp parallel for num_threads(chunks) if (chunks > 1)
+        for (int b = 0; b < buckets; b++)
+        {
+            uint32_t offset = mTotals[b];
+            for (int c = 0; c < chunks; c++)
+            {
+                uint32_t count = mCounts[c * buckets + b];
+                mCounts[c * buckets + b] = offset;
+                offset += count;
+            }
+            if (b < numKeys)
+                extents[b] = glm::uvec2(mTotals[b], offset);
+        }
+
+        // 3. scatter, each chunk in its input order
+#pragma omp parallel for num_threads(chunks) if (chunks > 1)
+        for (int c = 0; c < chunks; c++)
+        {
+            uint32_t *offset = &mCounts[c * buckets];
+            int begin = (long long)n * c / chunks;
+            int end = (long long)n * (c + 1) / chunks;
+            for (int i = begin; i < end; i++)
+            {
+                uint32_t b = keys[i] < (uint32_t)numKeys ? keys[i] : numKeys;
+                order[offset[b]++] = i;
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Glb
+{
+
+    static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+    {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, leaf, subleaf);
+        for (int i = 0; i < 4; i++)
+            regs[i] = r[i];
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // XCR0, the register states the OS saves
+    static unsigned long long xgetbv0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long)edx << 32) | eax;
+#endif
+    }
+
+    CpuFeatures::CpuFeatures() : mAVX2(false), mAVX512(false)
+    {
+        unsigned int regs[4];
+        cpuid(0, 0, regs);
+        unsigned int maxLeaf = regs[0];
+        if (maxLeaf < 7)
+            return;
+
+        // leaf 1 ECX: 27 OSXSAVE, 28 AVX
+        cpuid(1, 0, regs);
+        if ((regs[2] & (1u << 27)) == 0 || (regs[2] & (1u << 28)) == 0)
+            return;
+
+        // XCR0: 1 SSE, 2 AVX, 5 to 7 opmask and the upper ZMM registers
+        unsigned long long xcr0 = xgetbv0();
+        bool osAVX = (xcr0 & 0x6) == 0x6;
+        bool osAVX512 = (xcr0 & 0xe6) == 0xe6;
+
+        // leaf 7 EBX: 5 AVX2, 16 AVX512F
+        cpuid(7, 0, regs);
+        mAVX2 = osAVX && (regs[1] & (1u << 5)) != 0;
+        mAVX512 = osAVX512 && (regs[1] & (1u << 16)) != 0;
+    }
+
+    const CpuFeatures &CpuFeatures::get()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+
+    bool CpuFeatures::hasAVX2()
+    {
+        return get().mAVX2;
+    }
+
+    bool CpuFeatures::hasAVX512()
+    {
+        return get().mAVX512;
+    }
+}
@@ -0,0 +1,228 @@
+#include "DCT.h"
+
+#include <cmath>
+
+namespace Glb
+{
+
+    static const double PI = 3.14159265358979323846;
+
+    // plain complex product, std::complex's operator* also checks for infinities
+    static inline DCT::Complex mul(const DCT::Complex &a, const DCT::Complex &b)
+    {
+        return DCT::Complex(a.real() * b.real() - a.imag() * b.imag(),
+                            a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // the prime factors of n up to MAX_RADIX, radix 4 first, returns what is left
+    static int factorize(int n, std::vector<int> &factors)
+    {
+        factors.clear();
+        while (n % 4 == 0)
+        {
+            factors.push_back(4);
+            n /= 4;
+        }
+        for (int p = 2; p <= DCT::MAX_RADIX; p++)
+        {
+            while (n % p == 0)
+            {
+                factors.push_back(p);
+                n /= p;
+            }
+        }
+        return n;
+    }
+
+    void DCT::FFTPlan::init(int n)
+    {
+        this->n = n;
+        factorize(n, factors);
+
+        twiddle.resize(n);
+        for (int k = 0; k < n; k++)
+            twiddle[k] = std::polar(1.0, -2.0 * PI * k / n);
+    }
+
+    void DCT::FFTPlan::run(const Complex *in, Complex *out) const
+    {
+        recurse(in, 1, out, n, 0);
+    }
+
+    void DCT::FFTPlan::recurse(const Complex *in, int stride, Complex *out, int len, int level) const
+    {
+        // decimation in time: p sub-transforms of the samples r, r + p, r + 2p, ...
+        // then one radix-p butterfly per output k
+        if (len == 1)
+        {
+            out[0] = in[0];
+            return;
+        }
+
+        int p = factors[level];
+        int m = len / p;
+        for (int r = 0; r < p; r++)
+            recurse(in + r * stride, stride * p, out + r * m, m, level + 1);
+
+        int step = n / len;
+        int radixStep = n / p;
+        Complex t[MAX_RADIX];
+        for (int k = 0; k < m; k++)
+        {
+            t[0] = out[k];
+            for (int r = 1; r < p; r++)
+                t[r] = mul(out[r * m + k], twiddle[r * k * step]);
+
+            if (p == 2)
+            {
+                out[k] = t[0] + t[1];
+                out[m + k] = t[0] - t[1];
+            }
+            else if (p == 4)
+            {
+                Complex a0 = t[0] + t[2], a1 = t[0] - t[2];
+                Complex a2 = t[1] + t[3], d = t[1] - t[3];
+                Complex a3(d.imag(), -d.real()); // -i * d
+                out[k] = a0 + a2;
+                out[m + k] = a1 + a3;
+                out[2 * m + k] = a0 - a2;
+                out[3 * m + k] = a1 - a3;
+            }
+            else
+            {
+                for (int q = 0; q < p; q++)
+                {
+                    Complex sum = t[0];
+                    for (int r = 1; r < p; r++)
+                        sum += mul(t[r], twiddle[(r * q % p) * radixStep]);
+                    out[q * m + k] = sum;
+                }
+            }
+        }
+    }
+
+    DCT::DCT() : mSize(0), mBluestein(false)
+    {
+    }
+
+    DCT::~DCT()
+    {
+    }
+
+    void DCT::init(int n)
+    {
+        mSize = n;
+
+        std::vector<int> factors;
+        mBluestein = factorize(n, factors) > 1;
+
+        mShift.resize(n);
+        for (int k = 0; k < n; k++)
+            mShift[k] = std::polar(1.0, -PI * k / (2.0 * n));
+
+        mChirp.clear();
+        mKernel.clear();
+        if (!mBluestein)
+        {
+            mPlan.init(n);
+            return;
+        }
+
+        int m = 1;
+        while (m < 2 * n - 1)
+            m *= 2;
+        mPlan.init(m);
+
+        // k^2 is reduced mod 2n first so the angle stays accurate for long lines
+        mChirp.resize(n);
+        for (int k = 0; k < n; k++)
+        {
+            long long k2 = (long long)k * k % (2 * n);
+            mChirp[k] = std::polar(1.0, -PI * k2 / n);
+        }
+
+        std::vector<Complex> kernel(m, Complex(0.0, 0.0));
+        kernel[0] = std::conj(mChirp[0]);
+        for (int k = 1; k < n; k++)
+            kernel[k] = kernel[m - k] = std::conj(mChirp[k]);
+        mKernel.resize(m);
+        mPlan.run(kernel.data(), mKernel.data());
+    }
+
+    int DCT::size() const
+    {
+        return mSize;
+    }
+
+    int DCT::workSize() const
+    {
+        return mBluestein ? 2 * mSize + 2 * mPlan.n : 2 * mSize;
+    }
+
+    void DCT::fft(const Complex *in, Complex *out, Complex *work) const
+    {
+        if (!mBluestein)
+        {
+            mPlan.run(in, out);
+            return;
+        }
+
+        // Bluestein: the length n DFT as a circular convolution of power-of-two length
+        int n = mSize;
+        int m = mPlan.n;
+        Complex *a = work;
+        Complex *b = work + m;
+        for (int k = 0; k < n; k++)
+            a[k] = mul(in[k], mChirp[k]);
+        for (int k = n; k < m; k++)
+            a[k] = Complex(0.0, 0.0);
+
+        mPlan.run(a, b);
+        for (int k = 0; k < m; k++)
+            b[k] = std::conj(mul(b[k], mKernel[k]));
+        mPlan.run(b, a);
+
+        double scale = 1.0 / m;
+        for (int k = 0; k < n; k++)
+            out[k] = mul(std::conj(a[k]), mChirp[k]) * scale;
+    }
+
+    void DCT::forward(double *x, Complex *work) const
+    {
+        int n = mSize;
+        Complex *v = work;
+        Complex *V = work + n;
+
+        // even samples in order, then odd samples reversed
+        for (int i = 0; 2 * i < n; i++)
+            v[i] = Complex(x[2 * i], 0.0);
+        for (int i = 0; 2 * i + 1 < n; i++)
+            v[n - 1 - i] = Complex(x[2 * i + 1], 0.0);
+
+        fft(v, V, work + 2 * n);
+
+        for (int k = 0; k < n; k++)
+            x[k] = V[k].real() * mShift[k].real() - V[k].imag() * mShift[k].imag();
+    }
+
+    void DCT::inverse(double *x, Complex *work) const
+    {
+        int n = mSize;
+        Complex *V = work;
+        Complex *v = work + n;
+
+        // V is the conjugate of the reordered line's spectrum, so the real part of
+        // its forward FFT is n times the reordered line
+        V[0] = Complex(x[0], 0.0);
+        for (int k = 1; k < n; k++)
+            V[k] = mul(mShift[k], Complex(x[k], x[n - k]));
+
+        fft(V, v, work + 2 * n);
+
+        double scale = 1.0 / n;
+        for (int i = 0; 2 * i < n; i++)
+            x[2 * i] = v[i].real() * scale;
+        for (int i = 0; 2 * i + 1 < n; i++)
+            x[2 * i + 1] = v[n - 1 - i].real() * scale;
+    }
+}
@@ -0,0 +1,99 @@
+#include "FastPoisson2d.h"
+
+#include <cmath>
+
+namespace Glb
+{
+
+    static const double PI = 3.14159265358979323846;
+
+    FastPoisson2d::FastPoisson2d()
+    {
+        dim[0] = dim[1] = 0;
+    }
+
+    FastPoisson2d::~FastPoisson2d()
+    {
+    }
+
+    void FastPoisson2d::build(int dimX, int dimY)
+    {
+        dim[0] = dimX;
+        dim[1] = dimY;
+        for (int axis = 0; axis < 2; axis++)
+        {
+            int n = dim[axis];
+            mDCT[axis].init(n);
+            mEigen[axis].resize(n);
+            for (int k = 0; k < n; k++)
+                mEigen[axis][k] = 2.0 - 2.0 * cos(PI * k / n);
+        }
+    }
+
+    void FastPoisson2d::transform(double *x, int axis, bool inverse)
+    {
+        // every line along the axis is transformed on its own, columns are
+        // gathered into a contiguous buffer
+        int dimX = dim[0], dimY = dim[1];
+        int n = dim[axis];
+        int stride = axis == 0 ? 1 : dimX;
+        int lines = dimX * dimY / n;
+        const DCT &dct = mDCT[axis];
+
+#pragma omp parallel
+        {
+            std::vector<DCT::Complex> work(dct.workSize());
+            std::vector<double> line(n);
+
+#pragma omp for
+            for (int l = 0; l < lines; l++)
+            {
+                double *start = x + (l / stride) * stride * n + l % stride;
+                double *data = stride == 1 ? start : line.data();
+                if (stride != 1)
+                {
+                    for (int i = 0; i < n; i++)
+                        data[i] = start[i * stride];
+                }
+
+                if (inverse)
+                    dct.inverse(data, work.data());
+                else
+                    dct.forward(data, work.data());
+
+                if (stride != 1)
+                {
+                    for (int i = 0; i < n; i++)
+                        start[i * stride] = data[i];
+                }
+            }
+        }
+    }
+
+    void FastPoisson2d::solve(const ublas::vector<double> &b, ublas::vector<double> &x)
+    {
+        int dimX = dim[0], dimY = dim[1];
+        x = b;
+        double *xd = x.data().begin();
+
+        transform(xd, 0, false);
+        transform(xd, 1, false);
+
+        const double *eigenX = mEigen[0].data();
+        const double *eigenY = mEigen[1].data();
+
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            double *line = xd + j * dimX;
+            for (int i = 0; i < dimX; i++)
+            {
+                double eigen = eigenX[i] + eigenY[j];
+                line[i] = eigen > 0.0 ? line[i] / eigen : 0.0;
+            }
+        }
+
+        transform(xd, 1, true);
+        transform(xd, 0, true);
+    }
+}
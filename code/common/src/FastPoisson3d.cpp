@@ -0,0 +1,105 @@
+#include "FastPoisson3d.h"
+
+#include <cmath>
+
+namespace Glb
+{
+
+    static const double PI = 3.14159265358979323846;
+
+    FastPoisson3d::FastPoisson3d()
+    {
+        dim[0] = dim[1] = dim[2] = 0;
+    }
+
+    FastPoisson3d::~FastPoisson3d()
+    {
+    }
+
+    void FastPoisson3d::build(int dimX, int dimY, int dimZ)
+    {
+        dim[0] = dimX;
+        dim[1] = dimY;
+        dim[2] = dimZ;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int n = dim[axis];
+            mDCT[axis].init(n);
+            mEigen[axis].resize(n);
+            for (int k = 0; k < n; k++)
+                mEigen[axis][k] = 2.0 - 2.0 * cos(PI * k / n);
+        }
+    }
+
+    void FastPoisson3d::transform(double *x, int axis, bool inverse)
+    {
+        // every line along the axis is transformed on its own, gathered into a
+        // contiguous buffer unless the axis is i
+        int dimX = dim[0], dimY = dim[1], dimZ = dim[2];
+        int n = dim[axis];
+        int stride = axis == 0 ? 1 : (axis == 2 ? dimX : dimX * dimZ);
+        int lines = dimX * dimY * dimZ / n;
+        const DCT &dct = mDCT[axis];
+
+#pragma omp parallel
+        {
+            std::vector<DCT::Complex> work(dct.workSize());
+            std::vector<double> line(n);
+
+#pragma omp for
+            for (int l = 0; l < lines; l++)
+            {
+                double *start = x + (l / stride) * stride * n + l % stride;
+                double *data = stride == 1 ? start : line.data();
+                if (stride != 1)
+                {
+                    for (int i = 0; i < n; i++)
+                        data[i] = start[i * stride];
+                }
+
+                if (inverse)
+                    dct.inverse(data, work.data());
+                else
+                    dct.forward(data, work.data());
+
+                if (stride != 1)
+                {
+                    for (int i = 0; i < n; i++)
+                        start[i * stride] = data[i];
+                }
+            }
+        }
+    }
+
+    void FastPoisson3d::solve(const ublas::vector<double> &b, ublas::vector<double> &x)
+    {
+        int dimX = dim[0], dimY = dim[1], dimZ = dim[2];
+        int rows = dimY * dimZ;
+        x = b;
+        double *xd = x.data().begin();
+
+        for (int axis = 0; axis < 3; axis++)
+            transform(xd, axis, false);
+
+        const double *eigenX = mEigen[0].data();
+        const double *eigenY = mEigen[1].data();
+        const double *eigenZ = mEigen[2].data();
+
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            double eigenJK = eigenY[j] + eigenZ[k];
+            double *line = xd + row * dimX;
+            for (int i = 0; i < dimX; i++)
+            {
+                double eigen = eigenX[i] + eigenJK;
+                line[i] = eigen > 0.0 ? line[i] / eigen : 0.0;
+            }
+        }
+
+        for (int axis = 2; axis >= 0; axis--)
+            transform(xd, axis, true);
+    }
+}
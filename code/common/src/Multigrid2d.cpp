@@ -0,0 +1,299 @@
+#include "Multigrid2d.h"
+#include "ConjGradKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Glb
+{
+
+    // levels are added until the coarsest one has at most this many cells
+    static const int COARSEST_CELLS = 64;
+
+    Multigrid2d::Multigrid2d() : preSweeps(2), postSweeps(2), coarseSweeps(32)
+    {
+    }
+
+    Multigrid2d::~Multigrid2d()
+    {
+    }
+
+    int Multigrid2d::numLevels() const
+    {
+        return mA.size();
+    }
+
+    void Multigrid2d::build(const PoissonStencil2d &A)
+    {
+        mA.clear();
+        mWeightX.clear();
+        mWeightY.clear();
+        mDiag.clear();
+        mA.push_back(A);
+        mWeightX.resize(1);
+        mWeightY.resize(1);
+        mDiag.resize(1);
+
+        while (true)
+        {
+            const PoissonStencil2d &fine = mA.back();
+            int cells = fine.dim[0] * fine.dim[1];
+            if (cells <= COARSEST_CELLS || (fine.dim[0] == 1 && fine.dim[1] == 1))
+                break;
+
+            PoissonStencil2d coarse;
+            coarse.resize((fine.dim[0] + 1) / 2, (fine.dim[1] + 1) / 2);
+            for (int j = 0; j < fine.dim[1]; j++)
+                for (int i = 0; i < fine.dim[0]; i++)
+                {
+                    if (fine.isFluid(i, j))
+                        coarse.setFluid(i / 2, j / 2, true);
+                }
+
+            // a coarse face is crossed by the two fine faces between the children on
+            // either side of it; a face with a solid on one side adds nothing
+            int level = mA.size() - 1;
+            int dimX = coarse.dim[0], dimY = coarse.dim[1];
+            std::vector<double> wx(dimX * dimY), wy(dimX * dimY), diag(dimX * dimY);
+            for (int J = 0; J < dimY; J++)
+                for (int I = 0; I < dimX; I++)
+                {
+                    int index = I + J * dimX;
+                    wx[index] = 0.5 * (weightX(level, 2 * I + 1, 2 * J) + weightX(level, 2 * I + 1, 2 * J + 1));
+                    wy[index] = 0.5 * (weightY(level, 2 * I, 2 * J + 1) + weightY(level, 2 * I + 1, 2 * J + 1));
+                }
+            for (int J = 0; J < dimY; J++)
+                for (int I = 0; I < dimX; I++)
+                {
+                    int index = I + J * dimX;
+                    diag[index] = wx[index] + wy[index] + (I > 0 ? wx[index - 1] : 0.0) + (J > 0 ? wy[index - dimX] : 0.0);
+                }
+
+            mA.push_back(coarse);
+            mWeightX.push_back(wx);
+            mWeightY.push_back(wy);
+            mDiag.push_back(diag);
+        }
+
+        int levels = mA.size();
+        mX.resize(levels);
+        mB.resize(levels);
+        mR.resize(levels);
+        for (int l = 0; l < levels; l++)
+        {
+            int cells = mA[l].size1();
+            mX[l].resize(cells, false);
+            mB[l].resize(cells, false);
+            mR[l].resize(cells, false);
+        }
+    }
+
+    double Multigrid2d::weightX(int level, int i, int j) const
+    {
+        const PoissonStencil2d &A = mA[level];
+        if (i < 0 || i >= A.dim[0] - 1 || j < 0 || j >= A.dim[1])
+            return 0.0;
+        if (level == 0)
+            return A.isFluid(i, j) && A.isFluid(i + 1, j) ? 1.0 : 0.0;
+        return mWeightX[level][i + j * A.dim[0]];
+    }
+
+    double Multigrid2d::weightY(int level, int i, int j) const
+    {
+        const PoissonStencil2d &A = mA[level];
+        if (i < 0 || i >= A.dim[0] || j < 0 || j >= A.dim[1] - 1)
+            return 0.0;
+        if (level == 0)
+            return A.isFluid(i, j) && A.isFluid(i, j + 1) ? 1.0 : 0.0;
+        return mWeightY[level][i + j * A.dim[0]];
+    }
+
+    void Multigrid2d::relax(int level, int color)
+    {
+        const PoissonStencil2d &A = mA[level];
+        if (level == 0)
+        {
+            A.relax(mB[0], mX[0], 1.0, color);
+            return;
+        }
+
+        const double *b = mB[level].data().begin();
+        double *x = mX[level].data().begin();
+        const double *wx = mWeightX[level].data();
+        const double *wy = mWeightY[level].data();
+        const double *diag = mDiag[level].data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+
+        // cells of one color only read cells of the other, so rows can run in parallel
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int i0 = (j + color) & 1;
+            for (int i = i0; i < dimX; i += 2)
+            {
+                int index = i + j * dimX;
+                if (diag[index] == 0.0)
+                    continue;
+
+                double sum = b[index];
+                if (i > 0)
+                    sum += wx[index - 1] * x[index - 1];
+                if (i < dimX - 1)
+                    sum += wx[index] * x[index + 1];
+                if (j > 0)
+                    sum += wy[index - dimX] * x[index - dimX];
+                if (j < dimY - 1)
+                    sum += wy[index] * x[index + dimX];
+                x[index] = sum / diag[index];
+            }
+        }
+    }
+
+    void Multigrid2d::residual(int level)
+    {
+        const PoissonStencil2d &A = mA[level];
+        if (level == 0)
+        {
+            A.residual(mB[0], mX[0], mR[0], 1.0);
+            return;
+        }
+
+        const double *b = mB[level].data().begin();
+        const double *x = mX[level].data().begin();
+        double *r = mR[level].data().begin();
+        const double *wx = mWeightX[level].data();
+        const double *wy = mWeightY[level].data();
+        const double *diag = mDiag[level].data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            for (int i = 0; i < dimX; i++)
+            {
+                int index = i + j * dimX;
+                double sum = diag[index] * x[index];
+                if (i > 0)
+                    sum -= wx[index - 1] * x[index - 1];
+                if (i < dimX - 1)
+                    sum -= wx[index] * x[index + 1];
+                if (j > 0)
+                    sum -= wy[index - dimX] * x[index - dimX];
+                if (j < dimY - 1)
+                    sum -= wy[index] * x[index + dimX];
+                r[index] = b[index] - sum;
+            }
+        }
+    }
+
+    void Multigrid2d::restrictResidual(int level)
+    {
+        const PoissonStencil2d &fine = mA[level];
+        const PoissonStencil2d &coarse = mA[level + 1];
+        const double *r = mR[level].data().begin();
+        double *b = mB[level + 1].data().begin();
+
+        // every coarse cell gathers its own children, so rows can run in parallel
+#pragma omp parallel for
+        for (int J = 0; J < coarse.dim[1]; J++)
+        {
+            for (int I = 0; I < coarse.dim[0]; I++)
+            {
+                double sum = 0.0;
+                for (int j = 2 * J; j < 2 * J + 2 && j < fine.dim[1]; j++)
+                    for (int i = 2 * I; i < 2 * I + 2 && i < fine.dim[0]; i++)
+                        sum += r[i + j * fine.dim[0]];
+                b[I + J * coarse.dim[0]] = sum;
+            }
+        }
+    }
+
+    void Multigrid2d::prolongateCorrection(int level)
+    {
+        const PoissonStencil2d &fine = mA[level];
+        const PoissonStencil2d &coarse = mA[level + 1];
+        const double *e = mX[level + 1].data().begin();
+        double *x = mX[level].data().begin();
+
+#pragma omp parallel for
+        for (int j = 0; j < fine.dim[1]; j++)
+        {
+            int index = j * fine.dim[0];
+            int parentRow = (j / 2) * coarse.dim[0];
+            for (int i = 0; i < fine.dim[0]; i++, index++)
+            {
+                if (fine.isFluid(i, j))
+                    x[index] += e[parentRow + i / 2];
+            }
+        }
+    }
+
+    void Multigrid2d::vcycle(int level)
+    {
+        ublas::vector<double> &x = mX[level];
+        std::fill(x.begin(), x.end(), 0.0);
+
+        if (level == (int)mA.size() - 1)
+        {
+            // the coarsest system is tiny, so just relax it many times
+            for (int s = 0; s < coarseSweeps; s++)
+            {
+                relax(level, 0);
+                relax(level, 1);
+            }
+            for (int s = 0; s < coarseSweeps; s++)
+            {
+                relax(level, 1);
+                relax(level, 0);
+            }
+            return;
+        }
+
+        for (int s = 0; s < preSweeps; s++)
+        {
+            relax(level, 0);
+            relax(level, 1);
+        }
+
+        residual(level);
+        restrictResidual(level);
+        vcycle(level + 1);
+        prolongateCorrection(level);
+
+        for (int s = 0; s < postSweeps; s++)
+        {
+            relax(level, 1);
+            relax(level, 0);
+        }
+    }
+
+    void Multigrid2d::precondition(const ublas::vector<double> &r, ublas::vector<double> &z)
+    {
+        mB[0] = r;
+        vcycle(0);
+        z = mX[0];
+    }
+
+    bool Multigrid2d::solve(const ublas::vector<double> &b, ublas::vector<double> &x, int max_cycles, double tol, int &cycles, double &residual)
+    {
+        ublas::vector<double> r(b.size());
+        mA[0].residual(b, x, r, 1.0);
+        residual = sqrt(cg_dot(r, r));
+
+        for (cycles = 0; cycles < max_cycles; cycles++)
+        {
+            if (residual < tol)
+                return true;
+
+            // correct x with one V-cycle on the current residual
+            mB[0] = r;
+            vcycle(0);
+            x += mX[0];
+
+            mA[0].residual(b, x, r, 1.0);
+            residual = sqrt(cg_dot(r, r));
+        }
+
+        return residual < tol;
+    }
+}
@@ -0,0 +1,335 @@
+#include "Multigrid3d.h"
+#include "ConjGradKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Glb
+{
+
+    // levels are added until the coarsest one has at most this many cells
+    static const int COARSEST_CELLS = 64;
+
+    Multigrid3d::Multigrid3d() : preSweeps(2), postSweeps(2), coarseSweeps(32)
+    {
+    }
+
+    Multigrid3d::~Multigrid3d()
+    {
+    }
+
+    int Multigrid3d::numLevels() const
+    {
+        return mA.size();
+    }
+
+    void Multigrid3d::build(const PoissonStencil3d &A)
+    {
+        mA.clear();
+        mDiag.clear();
+        mA.push_back(A);
+        mDiag.resize(1);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            mWeight[axis].clear();
+            mWeight[axis].resize(1);
+        }
+
+        while (true)
+        {
+            const PoissonStencil3d &fine = mA.back();
+            int cells = fine.dim[0] * fine.dim[1] * fine.dim[2];
+            if (cells <= COARSEST_CELLS || (fine.dim[0] == 1 && fine.dim[1] == 1 && fine.dim[2] == 1))
+                break;
+
+            PoissonStencil3d coarse;
+            coarse.resize((fine.dim[0] + 1) / 2, (fine.dim[1] + 1) / 2, (fine.dim[2] + 1) / 2);
+            for (int j = 0; j < fine.dim[1]; j++)
+                for (int k = 0; k < fine.dim[2]; k++)
+                    for (int i = 0; i < fine.dim[0]; i++)
+                    {
+                        if (fine.isFluid(i, j, k))
+                            coarse.setFluid(i / 2, j / 2, k / 2, true);
+                    }
+
+            // a coarse face is crossed by the four fine faces between the children on
+            // either side of it; a face with a solid on one side adds nothing
+            int level = mA.size() - 1;
+            int dimX = coarse.dim[0], dimY = coarse.dim[1], dimZ = coarse.dim[2];
+            int strideK = dimX, strideJ = dimX * dimZ;
+            std::vector<double> w[3], diag(dimX * dimY * dimZ, 0.0);
+            for (int axis = 0; axis < 3; axis++)
+                w[axis].resize(dimX * dimY * dimZ);
+
+            for (int J = 0; J < dimY; J++)
+                for (int K = 0; K < dimZ; K++)
+                    for (int I = 0; I < dimX; I++)
+                    {
+                        int index = I + K * strideK + J * strideJ;
+                        int i = 2 * I, j = 2 * J, k = 2 * K;
+                        w[0][index] = 0.5 * (weight(level, 0, i + 1, j, k) + weight(level, 0, i + 1, j + 1, k) +
+                                             weight(level, 0, i + 1, j, k + 1) + weight(level, 0, i + 1, j + 1, k + 1));
+                        w[1][index] = 0.5 * (weight(level, 1, i, j + 1, k) + weight(level, 1, i + 1, j + 1, k) +
+                                             weight(level, 1, i, j + 1, k + 1) + weight(level, 1, i + 1, j + 1, k + 1));
+                        w[2][index] = 0.5 * (weight(level, 2, i, j, k + 1) + weight(level, 2, i + 1, j, k + 1) +
+                                             weight(level, 2, i, j + 1, k + 1) + weight(level, 2, i + 1, j + 1, k + 1));
+                    }
+
+            for (int J = 0; J < dimY; J++)
+                for (int K = 0; K < dimZ; K++)
+                    for (int I = 0; I < dimX; I++)
+                    {
+                        int index = I + K * strideK + J * strideJ;
+                        diag[index] = w[0][index] + w[1][index] + w[2][index] +
+                                      (I > 0 ? w[0][index - 1] : 0.0) +
+                                      (J > 0 ? w[1][index - strideJ] : 0.0) +
+                                      (K > 0 ? w[2][index - strideK] : 0.0);
+                    }
+
+            mA.push_back(coarse);
+            mDiag.push_back(diag);
+            for (int axis = 0; axis < 3; axis++)
+                mWeight[axis].push_back(w[axis]);
+        }
+
+        int levels = mA.size();
+        mX.resize(levels);
+        mB.resize(levels);
+        mR.resize(levels);
+        for (int l = 0; l < levels; l++)
+        {
+            int cells = mA[l].size1();
+            mX[l].resize(cells, false);
+            mB[l].resize(cells, false);
+            mR[l].resize(cells, false);
+        }
+    }
+
+    double Multigrid3d::weight(int level, int axis, int i, int j, int k) const
+    {
+        const PoissonStencil3d &A = mA[level];
+        int ni = i + (axis == 0), nj = j + (axis == 1), nk = k + (axis == 2);
+        if (i < 0 || j < 0 || k < 0 || ni >= A.dim[0] || nj >= A.dim[1] || nk >= A.dim[2])
+            return 0.0;
+        if (level == 0)
+            return A.isFluid(i, j, k) && A.isFluid(ni, nj, nk) ? 1.0 : 0.0;
+        return mWeight[axis][level][i + k * A.dim[0] + j * A.dim[0] * A.dim[2]];
+    }
+
+    void Multigrid3d::relax(int level, int color)
+    {
+        const PoissonStencil3d &A = mA[level];
+        if (level == 0)
+        {
+            A.relax(mB[0], mX[0], 1.0, color);
+            return;
+        }
+
+        const double *b = mB[level].data().begin();
+        double *x = mX[level].data().begin();
+        const double *wx = mWeight[0][level].data();
+        const double *wy = mWeight[1][level].data();
+        const double *wz = mWeight[2][level].data();
+        const double *diag = mDiag[level].data();
+        int dimX = A.dim[0], dimY = A.dim[1], dimZ = A.dim[2];
+        int strideK = dimX, strideJ = dimX * dimZ;
+        int rows = dimY * dimZ;
+
+        // cells of one color only read cells of the other, so rows can run in parallel
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            int i0 = (j + k + color) & 1;
+            for (int i = i0; i < dimX; i += 2)
+            {
+                int index = i + row * dimX;
+                if (diag[index] == 0.0)
+                    continue;
+
+                double sum = b[index];
+                if (i > 0)
+                    sum += wx[index - 1] * x[index - 1];
+                if (i < dimX - 1)
+                    sum += wx[index] * x[index + 1];
+                if (j > 0)
+                    sum += wy[index - strideJ] * x[index - strideJ];
+                if (j < dimY - 1)
+                    sum += wy[index] * x[index + strideJ];
+                if (k > 0)
+                    sum += wz[index - strideK] * x[index - strideK];
+                if (k < dimZ - 1)
+                    sum += wz[index] * x[index + strideK];
+                x[index] = sum / diag[index];
+            }
+        }
+    }
+
+    void Multigrid3d::residual(int level)
+    {
+        const PoissonStencil3d &A = mA[level];
+        if (level == 0)
+        {
+            A.residual(mB[0], mX[0], mR[0], 1.0);
+            return;
+        }
+
+        const double *b = mB[level].data().begin();
+        const double *x = mX[level].data().begin();
+        double *r = mR[level].data().begin();
+        const double *wx = mWeight[0][level].data();
+        const double *wy = mWeight[1][level].data();
+        const double *wz = mWeight[2][level].data();
+        const double *diag = mDiag[level].data();
+        int dimX = A.dim[0], dimY = A.dim[1], dimZ = A.dim[2];
+        int strideK = dimX, strideJ = dimX * dimZ;
+        int rows = dimY * dimZ;
+
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            for (int i = 0; i < dimX; i++)
+            {
+                int index = i + row * dimX;
+                double sum = diag[index] * x[index];
+                if (i > 0)
+                    sum -= wx[index - 1] * x[index - 1];
+                if (i < dimX - 1)
+                    sum -= wx[index] * x[index + 1];
+                if (j > 0)
+                    sum -= wy[index - strideJ] * x[index - strideJ];
+                if (j < dimY - 1)
+                    sum -= wy[index] * x[index + strideJ];
+                if (k > 0)
+                    sum -= wz[index - strideK] * x[index - strideK];
+                if (k < dimZ - 1)
+                    sum -= wz[index] * x[index + strideK];
+                r[index] = b[index] - sum;
+            }
+        }
+    }
+
+    void Multigrid3d::restrictResidual(int level)
+    {
+        const PoissonStencil3d &fine = mA[level];
+        const PoissonStencil3d &coarse = mA[level + 1];
+        const double *r = mR[level].data().begin();
+        double *b = mB[level + 1].data().begin();
+        int rows = coarse.dim[1] * coarse.dim[2];
+
+        // every coarse cell gathers its own children, so rows can run in parallel
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int J = row / coarse.dim[2];
+            int K = row - J * coarse.dim[2];
+            for (int I = 0; I < coarse.dim[0]; I++)
+            {
+                double sum = 0.0;
+                for (int j = 2 * J; j < 2 * J + 2 && j < fine.dim[1]; j++)
+                    for (int k = 2 * K; k < 2 * K + 2 && k < fine.dim[2]; k++)
+                    {
+                        int child = (k + j * fine.dim[2]) * fine.dim[0];
+                        for (int i = 2 * I; i < 2 * I + 2 && i < fine.dim[0]; i++)
+                            sum += r[child + i];
+                    }
+                b[row * coarse.dim[0] + I] = sum;
+            }
+        }
+    }
+
+    void Multigrid3d::prolongateCorrection(int level)
+    {
+        const PoissonStencil3d &fine = mA[level];
+        const PoissonStencil3d &coarse = mA[level + 1];
+        const double *e = mX[level + 1].data().begin();
+        double *x = mX[level].data().begin();
+        int rows = fine.dim[1] * fine.dim[2];
+
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / fine.dim[2];
+            int k = row - j * fine.dim[2];
+            int index = row * fine.dim[0];
+            int parentRow = (k / 2) * coarse.dim[0] + (j / 2) * coarse.dim[0] * coarse.dim[2];
+            for (int i = 0; i < fine.dim[0]; i++, index++)
+            {
+                if (fine.isFluid(i, j, k))
+                    x[index] += e[parentRow + i / 2];
+            }
+        }
+    }
+
+    void Multigrid3d::vcycle(int level)
+    {
+        ublas::vector<double> &x = mX[level];
+        std::fill(x.begin(), x.end(), 0.0);
+
+        if (level == (int)mA.size() - 1)
+        {
+            // the coarsest system is tiny, so just relax it many times
+            for (int s = 0; s < coarseSweeps; s++)
+            {
+                relax(level, 0);
+                relax(level, 1);
+            }
+            for (int s = 0; s < coarseSweeps; s++)
+            {
+                relax(level, 1);
+                relax(level, 0);
+            }
+            return;
+        }
+
+        for (int s = 0; s < preSweeps; s++)
+        {
+            relax(level, 0);
+            relax(level, 1);
+        }
+
+        residual(level);
+        restrictResidual(level);
+        vcycle(level + 1);
+        prolongateCorrection(level);
+
+        for (int s = 0; s < postSweeps; s++)
+        {
+            relax(level, 1);
+            relax(level, 0);
+        }
+    }
+
+    void Multigrid3d::precondition(const ublas::vector<double> &r, ublas::vector<double> &z)
+    {
+        mB[0] = r;
+        vcycle(0);
+        z = mX[0];
+    }
+
+    bool Multigrid3d::solve(const ublas::vector<double> &b, ublas::vector<double> &x, int max_cycles, double tol, int &cycles, double &residual)
+    {
+        ublas::vector<double> r(b.size());
+        mA[0].residual(b, x, r, 1.0);
+        residual = sqrt(cg_dot(r, r));
+
+        for (cycles = 0; cycles < max_cycles; cycles++)
+        {
+            if (residual < tol)
+                return true;
+
+            // correct x with one V-cycle on the current residual
+            mB[0] = r;
+            vcycle(0);
+            x += mX[0];
+
+            mA[0].residual(b, x, r, 1.0);
+            residual = sqrt(cg_dot(r, r));
+        }
+
+        return residual < tol;
+    }
+}
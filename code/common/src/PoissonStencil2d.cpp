@@ -0,0 +1,211 @@
+#include "PoissonStencil2d.h"
+#include "ConjGradKernels.h"
+
+namespace Glb
+{
+
+    PoissonStencil2d::PoissonStencil2d() : strideJ(0)
+    {
+        dim[0] = dim[1] = 0;
+    }
+
+    PoissonStencil2d::~PoissonStencil2d()
+    {
+    }
+
+    void PoissonStencil2d::resize(int dimX, int dimY)
+    {
+        dim[0] = dimX;
+        dim[1] = dimY;
+        strideJ = dimX + 2;
+        mFluid.assign((dimX + 2) * (dimY + 2), 0);
+    }
+
+    int PoissonStencil2d::padded(int i, int j) const
+    {
+        return (i + 1) + (j + 1) * strideJ;
+    }
+
+    bool PoissonStencil2d::setFluid(int i, int j, bool fluid)
+    {
+        unsigned char &flag = mFluid[padded(i, j)];
+        if (flag == (unsigned char)fluid)
+            return false;
+        flag = fluid;
+        return true;
+    }
+
+    bool PoissonStencil2d::isFluid(int i, int j) const
+    {
+        if (i < 0 || i > dim[0] - 1 || j < 0 || j > dim[1] - 1)
+            return false;
+        return mFluid[padded(i, j)] != 0;
+    }
+
+    unsigned int PoissonStencil2d::size1() const
+    {
+        return dim[0] * dim[1];
+    }
+
+    double PoissonStencil2d::operator()(int row, int col) const
+    {
+        int j = row / dim[0];
+        int i = row - j * dim[0];
+        if (!isFluid(i, j))
+            return 0.0;
+
+        if (row == col)
+        {
+            int p = padded(i, j);
+            return mFluid[p - 1] + mFluid[p + 1] + mFluid[p - strideJ] + mFluid[p + strideJ];
+        }
+
+        int cj = col / dim[0];
+        int ci = col - cj * dim[0];
+        if (abs(i - ci) + abs(j - cj) == 1 && isFluid(ci, cj))
+            return -1.0;
+        return 0.0;
+    }
+
+    void PoissonStencil2d::apply(const ublas::vector<double> &x, ublas::vector<double> &y) const
+    {
+        applyAndDot(x, y);
+    }
+
+    double PoissonStencil2d::applyAndDot(const ublas::vector<double> &x, ublas::vector<double> &y) const
+    {
+        const double *xd = x.data().begin();
+        double *yd = y.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1];
+        int padJ = strideJ;
+        int cellJ = dimX;
+
+        // one partial sum per row of cells, added in order, so the dot product
+        // does not depend on how the rows were split between threads
+        std::vector<double> partial(dimY);
+
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int index = j * dimX;
+            int p = padded(0, j);
+            double dot = 0.0;
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    yd[index] = 0.0;
+                    continue;
+                }
+
+                double xc = xd[index];
+                double sum = 0.0;
+                if (f[p - 1])
+                    sum += xc - xd[index - 1];
+                if (f[p + 1])
+                    sum += xc - xd[index + 1];
+                if (f[p - padJ])
+                    sum += xc - xd[index - cellJ];
+                if (f[p + padJ])
+                    sum += xc - xd[index + cellJ];
+
+                yd[index] = sum;
+                dot += xc * sum;
+            }
+            partial[j] = dot;
+        }
+
+        return cg_sum(partial.data(), dimY);
+    }
+
+    void PoissonStencil2d::residual(const ublas::vector<double> &b, const ublas::vector<double> &x, ublas::vector<double> &r, double scale) const
+    {
+        const double *bd = b.data().begin();
+        const double *xd = x.data().begin();
+        double *rd = r.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1];
+        int padJ = strideJ;
+        int cellJ = dimX;
+
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int index = j * dimX;
+            int p = padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    rd[index] = 0.0;
+                    continue;
+                }
+
+                double xc = xd[index];
+                double sum = 0.0;
+                if (f[p - 1])
+                    sum += xc - xd[index - 1];
+                if (f[p + 1])
+                    sum += xc - xd[index + 1];
+                if (f[p - padJ])
+                    sum += xc - xd[index - cellJ];
+                if (f[p + padJ])
+                    sum += xc - xd[index + cellJ];
+
+                rd[index] = bd[index] - scale * sum;
+            }
+        }
+    }
+
+    void PoissonStencil2d::relax(const ublas::vector<double> &b, ublas::vector<double> &x, double scale, int color) const
+    {
+        const double *bd = b.data().begin();
+        double *xd = x.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1];
+        int padJ = strideJ;
+        int cellJ = dimX;
+        double invScale = 1.0 / scale;
+
+        // cells of one color only read cells of the other, so rows can run in parallel
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int i0 = (j + color) & 1;
+            int index = i0 + j * cellJ;
+            int p = padded(i0, j);
+            for (int i = i0; i < dimX; i += 2, index += 2, p += 2)
+            {
+                if (!f[p])
+                    continue;
+
+                int count = 0;
+                double sum = 0.0;
+                if (f[p - 1])
+                {
+                    sum += xd[index - 1];
+                    count++;
+                }
+                if (f[p + 1])
+                {
+                    sum += xd[index + 1];
+                    count++;
+                }
+                if (f[p - padJ])
+                {
+                    sum += xd[index - cellJ];
+                    count++;
+                }
+                if (f[p + padJ])
+                {
+                    sum += xd[index + cellJ];
+                    count++;
+                }
+
+                if (count > 0)
+                    xd[index] = (bd[index] * invScale + sum) / count;
+            }
+        }
+    }
+}
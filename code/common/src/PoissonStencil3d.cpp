@@ -0,0 +1,252 @@
+#include "PoissonStencil3d.h"
+#include "ConjGradKernels.h"
+
+namespace Glb
+{
+
+    PoissonStencil3d::PoissonStencil3d() : strideK(0), strideJ(0)
+    {
+        dim[0] = dim[1] = dim[2] = 0;
+    }
+
+    PoissonStencil3d::~PoissonStencil3d()
+    {
+    }
+
+    void PoissonStencil3d::resize(int dimX, int dimY, int dimZ)
+    {
+        dim[0] = dimX;
+        dim[1] = dimY;
+        dim[2] = dimZ;
+        strideK = dimX + 2;
+        strideJ = (dimX + 2) * (dimZ + 2);
+        mFluid.assign((dimX + 2) * (dimY + 2) * (dimZ + 2), 0);
+    }
+
+    int PoissonStencil3d::padded(int i, int j, int k) const
+    {
+        return (i + 1) + (k + 1) * strideK + (j + 1) * strideJ;
+    }
+
+    bool PoissonStencil3d::setFluid(int i, int j, int k, bool fluid)
+    {
+        unsigned char &flag = mFluid[padded(i, j, k)];
+        if (flag == (unsigned char)fluid)
+            return false;
+        flag = fluid;
+        return true;
+    }
+
+    bool PoissonStencil3d::isFluid(int i, int j, int k) const
+    {
+        if (i < 0 || i > dim[0] - 1 ||
+            j < 0 || j > dim[1] - 1 ||
+            k < 0 || k > dim[2] - 1)
+            return false;
+        return mFluid[padded(i, j, k)] != 0;
+    }
+
+    unsigned int PoissonStencil3d::size1() const
+    {
+        return dim[0] * dim[1] * dim[2];
+    }
+
+    double PoissonStencil3d::operator()(int row, int col) const
+    {
+        int j = row / (dim[0] * dim[2]);
+        int k = (row - j * dim[0] * dim[2]) / dim[0];
+        int i = row - j * dim[0] * dim[2] - k * dim[0];
+        if (!isFluid(i, j, k))
+            return 0.0;
+
+        if (row == col)
+        {
+            int p = padded(i, j, k);
+            return mFluid[p - 1] + mFluid[p + 1] +
+                   mFluid[p - strideK] + mFluid[p + strideK] +
+                   mFluid[p - strideJ] + mFluid[p + strideJ];
+        }
+
+        int cj = col / (dim[0] * dim[2]);
+        int ck = (col - cj * dim[0] * dim[2]) / dim[0];
+        int ci = col - cj * dim[0] * dim[2] - ck * dim[0];
+        int distance = abs(i - ci) + abs(j - cj) + abs(k - ck);
+        if (distance == 1 && isFluid(ci, cj, ck))
+            return -1.0;
+        return 0.0;
+    }
+
+    void PoissonStencil3d::apply(const ublas::vector<double> &x, ublas::vector<double> &y) const
+    {
+        applyAndDot(x, y);
+    }
+
+    double PoissonStencil3d::applyAndDot(const ublas::vector<double> &x, ublas::vector<double> &y) const
+    {
+        const double *xd = x.data().begin();
+        double *yd = y.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1], dimZ = dim[2];
+        int padK = strideK, padJ = strideJ;
+        int cellK = dimX;
+        int cellJ = dimX * dimZ;
+
+        // one partial sum per row of cells, added in order, so the dot product
+        // does not depend on how the rows were split between threads
+        int rows = dimY * dimZ;
+        std::vector<double> partial(rows);
+
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            int index = row * dimX;
+            int p = padded(0, j, k);
+            double dot = 0.0;
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    yd[index] = 0.0;
+                    continue;
+                }
+
+                double xc = xd[index];
+                double sum = 0.0;
+                if (f[p - 1])
+                    sum += xc - xd[index - 1];
+                if (f[p + 1])
+                    sum += xc - xd[index + 1];
+                if (f[p - padK])
+                    sum += xc - xd[index - cellK];
+                if (f[p + padK])
+                    sum += xc - xd[index + cellK];
+                if (f[p - padJ])
+                    sum += xc - xd[index - cellJ];
+                if (f[p + padJ])
+                    sum += xc - xd[index + cellJ];
+
+                yd[index] = sum;
+                dot += xc * sum;
+            }
+            partial[row] = dot;
+        }
+
+        return cg_sum(partial.data(), rows);
+    }
+
+    void PoissonStencil3d::residual(const ublas::vector<double> &b, const ublas::vector<double> &x, ublas::vector<double> &r, double scale) const
+    {
+        const double *bd = b.data().begin();
+        const double *xd = x.data().begin();
+        double *rd = r.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1], dimZ = dim[2];
+        int padK = strideK, padJ = strideJ;
+        int cellK = dimX;
+        int cellJ = dimX * dimZ;
+        int rows = dimY * dimZ;
+
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            int index = row * dimX;
+            int p = padded(0, j, k);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    rd[index] = 0.0;
+                    continue;
+                }
+
+                double xc = xd[index];
+                double sum = 0.0;
+                if (f[p - 1])
+                    sum += xc - xd[index - 1];
+                if (f[p + 1])
+                    sum += xc - xd[index + 1];
+                if (f[p - padK])
+                    sum += xc - xd[index - cellK];
+                if (f[p + padK])
+                    sum += xc - xd[index + cellK];
+                if (f[p - padJ])
+                    sum += xc - xd[index - cellJ];
+                if (f[p + padJ])
+                    sum += xc - xd[index + cellJ];
+
+                rd[index] = bd[index] - scale * sum;
+            }
+        }
+    }
+
+    void PoissonStencil3d::relax(const ublas::vector<double> &b, ublas::vector<double> &x, double scale, int color) const
+    {
+        const double *bd = b.data().begin();
+        double *xd = x.data().begin();
+        const unsigned char *f = mFluid.data();
+        int dimX = dim[0], dimY = dim[1], dimZ = dim[2];
+        int padK = strideK, padJ = strideJ;
+        int cellK = dimX;
+        int cellJ = dimX * dimZ;
+        double invScale = 1.0 / scale;
+        int rows = dimY * dimZ;
+
+        // cells of one color only read cells of the other, so rows can run in parallel
+#pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            int j = row / dimZ;
+            int k = row - j * dimZ;
+            // first cell of this row with the requested color
+            int i0 = (j + k + color) & 1;
+            int index = row * dimX + i0;
+            int p = padded(i0, j, k);
+            for (int i = i0; i < dimX; i += 2, index += 2, p += 2)
+            {
+                if (!f[p])
+                    continue;
+
+                int count = 0;
+                double sum = 0.0;
+                if (f[p - 1])
+                {
+                    sum += xd[index - 1];
+                    count++;
+                }
+                if (f[p + 1])
+                {
+                    sum += xd[index + 1];
+                    count++;
+                }
+                if (f[p - padK])
+                {
+                    sum += xd[index - cellK];
+                    count++;
+                }
+                if (f[p + padK])
+                {
+                    sum += xd[index + cellK];
+                    count++;
+                }
+                if (f[p - padJ])
+                {
+                    sum += xd[index - cellJ];
+                    count++;
+                }
+                if (f[p + padJ])
+                {
+                    sum += xd[index + cellJ];
+                    count++;
+                }
+
+                // an isolated fluid cell has an empty row, leave it alone
+                if (count > 0)
+                    xd[index] = (bd[index] * invScale + sum) / count;
+            }
+        }
+    }
+}
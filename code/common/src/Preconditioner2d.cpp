@@ -0,0 +1,333 @@
+#include "Preconditioner2d.h"
+
+#include <cmath>
+
+namespace Glb
+{
+
+    // MIC(0) parameters, see Bridson's "Fluid Simulation for Computer Graphics"
+    static const double MIC_TAU = 0.97;
+    static const double MIC_SIGMA = 0.25;
+
+    Preconditioner2d::Preconditioner2d() : type(IC0), mA(NULL)
+    {
+    }
+
+    Preconditioner2d::~Preconditioner2d()
+    {
+    }
+
+    void Preconditioner2d::build(const PoissonStencil2d &A, int type)
+    {
+        this->type = type;
+        mA = &A;
+        mPrecon.assign(A.size1(), 0.0);
+        mTemp.assign(A.size1(), 0.0);
+
+        switch (type)
+        {
+        case IC0:
+            buildIC0();
+            break;
+        case RedBlackMIC0:
+            buildRedBlackMIC0();
+            break;
+        default:
+        {
+            // Jacobi and incomplete Poisson only need 1 / diag(A)
+            const unsigned char *f = A.mFluid.data();
+            int dimX = A.dim[0], dimY = A.dim[1];
+            int padJ = A.strideJ;
+
+#pragma omp parallel for
+            for (int j = 0; j < dimY; j++)
+            {
+                int index = j * dimX;
+                int p = A.padded(0, j);
+                for (int i = 0; i < dimX; i++, index++, p++)
+                {
+                    int diag = f[p - 1] + f[p + 1] + f[p - padJ] + f[p + padJ];
+                    if (f[p] && diag > 0)
+                        mPrecon[index] = 1.0 / diag;
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    void Preconditioner2d::buildIC0()
+    {
+        // IC(0) in cell order: the pivot of a cell depends on its two predecessors
+        const PoissonStencil2d &A = *mA;
+        const unsigned char *f = A.mFluid.data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+        int padJ = A.strideJ;
+        int cellJ = dimX;
+        double *precon = mPrecon.data();
+
+        int index = 0;
+        for (int j = 0; j < dimY; j++)
+        {
+            int p = A.padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                    continue;
+
+                double e = f[p - 1] + f[p + 1] + f[p - padJ] + f[p + padJ];
+                if (f[p - 1])
+                    e -= precon[index - 1] * precon[index - 1];
+                if (f[p - padJ])
+                    e -= precon[index - cellJ] * precon[index - cellJ];
+
+                precon[index] = e > 0.0 ? 1.0 / sqrt(e) : 0.0;
+            }
+        }
+    }
+
+    void Preconditioner2d::buildRedBlackMIC0()
+    {
+        // Red cells, (i + j) even, come first and have no red neighbours, so their
+        // pivot is the diagonal. A black cell is coupled to its red neighbours only,
+        // and all the fill-in between two black cells through a red one is dropped.
+        const PoissonStencil2d &A = *mA;
+        const unsigned char *f = A.mFluid.data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+        int padJ = A.strideJ;
+        double *precon = mPrecon.data();
+
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int index = j * dimX;
+            int p = A.padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                    continue;
+
+                int diag = f[p - 1] + f[p + 1] + f[p - padJ] + f[p + padJ];
+                if (diag == 0)
+                    continue;
+
+                if (((i + j) & 1) == 0)
+                {
+                    precon[index] = 1.0 / sqrt((double)diag);
+                    continue;
+                }
+
+                int neighbours[4] = {p - 1, p + 1, p - padJ, p + padJ};
+                double e = diag;
+                for (int n = 0; n < 4; n++)
+                {
+                    int q = neighbours[n];
+                    if (!f[q])
+                        continue;
+                    int diagN = f[q - 1] + f[q + 1] + f[q - padJ] + f[q + padJ];
+                    e -= (1.0 + MIC_TAU * (diagN - 1)) / diagN;
+                }
+                if (e < MIC_SIGMA * diag)
+                    e = diag;
+
+                precon[index] = 1.0 / sqrt(e);
+            }
+        }
+    }
+
+    void Preconditioner2d::apply(const ublas::vector<double> &r, ublas::vector<double> &z)
+    {
+        const double *rd = r.data().begin();
+        double *zd = z.data().begin();
+
+        switch (type)
+        {
+        case IC0:
+            applyIC0(rd, zd);
+            break;
+        case Jacobi:
+            applyJacobi(rd, zd);
+            break;
+        case IncompletePoisson:
+            applyIncompletePoisson(rd, zd);
+            break;
+        case RedBlackMIC0:
+            applyRedBlackMIC0(rd, zd);
+            break;
+        }
+    }
+
+    void Preconditioner2d::applyIC0(const double *r, double *z)
+    {
+        const PoissonStencil2d &A = *mA;
+        const unsigned char *f = A.mFluid.data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+        int padJ = A.strideJ;
+        int cellJ = dimX;
+        const double *precon = mPrecon.data();
+        double *q = mTemp.data();
+
+        // solve L * q = r
+        int index = 0;
+        for (int j = 0; j < dimY; j++)
+        {
+            int p = A.padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                double t = r[index];
+                if (f[p - 1])
+                    t += precon[index - 1] * q[index - 1];
+                if (f[p - padJ])
+                    t += precon[index - cellJ] * q[index - cellJ];
+                q[index] = t * precon[index];
+            }
+        }
+
+        // solve L^T * z = q
+        index = dimX * dimY - 1;
+        for (int j = dimY - 1; j >= 0; j--)
+        {
+            int p = A.padded(dimX - 1, j);
+            for (int i = dimX - 1; i >= 0; i--, index--, p--)
+            {
+                double t = q[index];
+                if (f[p + 1])
+                    t += precon[index] * z[index + 1];
+                if (f[p + padJ])
+                    t += precon[index] * z[index + cellJ];
+                z[index] = t * precon[index];
+            }
+        }
+    }
+
+    void Preconditioner2d::applyJacobi(const double *r, double *z)
+    {
+        const double *invDiag = mPrecon.data();
+        int n = mPrecon.size();
+
+#pragma omp parallel for
+        for (int index = 0; index < n; index++)
+            z[index] = r[index] * invDiag[index];
+    }
+
+    void Preconditioner2d::applyIncompletePoisson(const double *r, double *z)
+    {
+        const PoissonStencil2d &A = *mA;
+        const unsigned char *f = A.mFluid.data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+        int padJ = A.strideJ;
+        int cellJ = dimX;
+        const double *invDiag = mPrecon.data();
+        double *y = mTemp.data();
+
+        // y = K^T * r, each cell adds its upper fluid neighbours
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int index = j * dimX;
+            int p = A.padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    y[index] = 0.0;
+                    continue;
+                }
+                double sum = 0.0;
+                if (f[p + 1])
+                    sum += r[index + 1];
+                if (f[p + padJ])
+                    sum += r[index + cellJ];
+                y[index] = r[index] + invDiag[index] * sum;
+            }
+        }
+
+        // z = K * y, each cell adds its lower fluid neighbours
+#pragma omp parallel for
+        for (int j = 0; j < dimY; j++)
+        {
+            int index = j * dimX;
+            int p = A.padded(0, j);
+            for (int i = 0; i < dimX; i++, index++, p++)
+            {
+                if (!f[p])
+                {
+                    z[index] = 0.0;
+                    continue;
+                }
+                double sum = y[index];
+                if (f[p - 1])
+                    sum += invDiag[index - 1] * y[index - 1];
+                if (f[p - padJ])
+                    sum += invDiag[index - cellJ] * y[index - cellJ];
+                z[index] = sum;
+            }
+        }
+    }
+
+    void Preconditioner2d::applyRedBlackMIC0(const double *r, double *z)
+    {
+        const PoissonStencil2d &A = *mA;
+        const unsigned char *f = A.mFluid.data();
+        int dimX = A.dim[0], dimY = A.dim[1];
+        int padJ = A.strideJ;
+        int cellJ = dimX;
+        const double *precon = mPrecon.data();
+        double *q = mTemp.data();
+
+        // L * q = r: red cells first, then black cells from their red neighbours.
+        // L^T * z = q runs the colors in reverse order.
+        for (int pass = 0; pass < 4; pass++)
+        {
+            int color = (pass == 0 || pass == 3) ? 0 : 1;
+            bool forward = pass < 2;
+
+#pragma omp parallel for
+            for (int j = 0; j < dimY; j++)
+            {
+                int i0 = (j + color) & 1;
+                int index = j * dimX + i0;
+                int p = A.padded(i0, j);
+                for (int i = i0; i < dimX; i += 2, index += 2, p += 2)
+                {
+                    double c = precon[index];
+                    double t;
+                    if (forward)
+                    {
+                        t = r[index];
+                        if (color == 1)
+                        {
+                            if (f[p - 1])
+                                t += precon[index - 1] * q[index - 1];
+                            if (f[p + 1])
+                                t += precon[index + 1] * q[index + 1];
+                            if (f[p - padJ])
+                                t += precon[index - cellJ] * q[index - cellJ];
+                            if (f[p + padJ])
+                                t += precon[index + cellJ] * q[index + cellJ];
+                        }
+                        q[index] = t * c;
+                    }
+                    else
+                    {
+                        t = q[index];
+                        if (color == 0)
+                        {
+                            double sum = 0.0;
+                            if (f[p - 1])
+                                sum += z[index - 1];
+                            if (f[p + 1])
+                                sum += z[index + 1];
+                            if (f[p - padJ])
+                                sum += z[index - cellJ];
+                            if (f[p + padJ])
+                                sum += z[index + cellJ];
+                            t += c * sum;
+                        }
+                        z[index] = t * c;
+                    }
+                }
+            }
+        }
+    }
+}
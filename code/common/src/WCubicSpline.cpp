@@ -4,28 +4,15 @@
 
 namespace Glb {
 
-    WCubicSpline2d::WCubicSpline2d(float h) {
-        mH = h;
-        mH2 = h * h;
-        mSigma = 40.0 / (7.0 * glm::pi<float>() * mH2);
-
-        mBufferSize = glm::uvec2(128, 128);
-        mGradBuffer = std::vector<std::vector<glm::vec2>>(mBufferSize.x, std::vector<glm::vec2>(mBufferSize.y));
-        mValueBuffer = std::vector<float>(mBufferSize.x);
-
-        for (int i = 0; i < mBufferSize.x; i++) {
-            for (int j = 0; j < mBufferSize.y; j++) {
-                float x = ((float)i + 0.5f) * mH / mBufferSize.x;
-                float y = ((float)j + 0.5f) * mH / mBufferSize.y;
-                glm::vec2 radius(x, y);
-                mGradBuffer[i][j] = CalculateGrad(radius);
-            }
-        }
+    constexpr float WCubicSplineTable2d::SIGMA;
+    constexpr WCubicSplineTable2d WCubicSpline2d::sTable;
 
-        for (int i = 0; i < mBufferSize.x; i++) {
-            float distance = ((float)i + 0.5f) * mH / mBufferSize.x;
-            mValueBuffer[i] = CalculateValue(distance);
-        }
+    WCubicSpline2d::WCubicSpline2d(float h, bool interpolate) {
+        mH = h;
+        mTableScale = WCubicSplineTable2d::SIZE / h;
+        mValueScale = 1.0f / (h * h);
+        mGradScale = mValueScale * mValueScale;
+        mInterpolate = interpolate;
     }
 
     WCubicSpline2d::~WCubicSpline2d() {
@@ -33,76 +20,42 @@ namespace Glb {
     }
 
     float WCubicSpline2d::Value(float distance) {
-        float res = 0;
-        int i = (std::abs(distance) * mBufferSize.x / mH);
-        if (i >= mBufferSize.x) {
-            return res;
-        }
-        res = mValueBuffer[i];
-        return res;
+        return ValueAndGradFactor(distance).x;
     }
 
     glm::vec2 WCubicSpline2d::Grad(glm::vec2 radius) {
-        glm::vec2 res(0.0f, 0.0f);
+        return Grad(radius, glm::length(radius));
+    }
 
-        int i = (std::abs(radius.x) * mBufferSize.x / mH);
-        int j = (std::abs(radius.y) * mBufferSize.x / mH);
+    glm::vec2 WCubicSpline2d::Grad(glm::vec2 radius, float distance) {
+        return ValueAndGradFactor(distance).y * radius;
+    }
 
-        if (i >= mBufferSize.x || j >= mBufferSize.y) {
-            return res;
+    glm::vec2 WCubicSpline2d::ValueAndGradFactor(float distance) {
+        float x = std::abs(distance) * mTableScale;
+        if (!(x < WCubicSplineTable2d::SIZE)) {
+            return glm::vec2(0.0f, 0.0f);
         }
 
-        res = mGradBuffer[i][j];
-
-        if (radius.x < 0) {
-            res.x = -res.x;
-        }
-        if (radius.y < 0) {
-            res.y = -res.y;
+        if (!mInterpolate) {
+            const float* e = sTable.data[(int)(x + 0.5f)];
+            return glm::vec2(e[0] * mValueScale, e[1] * mGradScale);
         }
 
-        return res;
+        int i = (int)x;
+        float t = x - i;
+        const float* e0 = sTable.data[i];
+        const float* e1 = sTable.data[i + 1];
+        return glm::vec2((e0[0] + t * (e1[0] - e0[0])) * mValueScale,
+                         (e0[1] + t * (e1[1] - e0[1])) * mGradScale);
     }
 
-    float WCubicSpline2d::CalculateValue(float distance) {
-        float r = std::abs(distance);
-        float q = r / mH;
-        float q2 = q * q;
-        float q3 = q * q2;
-        float res = 0.0f;
-        if (q < 0.5f) {
-            res = 6.0f * (q3 - q2) + 1.0f;
-            res *= mSigma;
-            return res;
-        }
-        else if (q >= 0.5f && q < 1.0f) {
-            res = 1.0f - q;
-            res = std::pow(res, 3) * 2.0f;
-            res *= mSigma;
-            return res;
-        }
-        return res;
+    float WCubicSpline2d::GetH() {
+        return mH;
     }
 
-    glm::vec2 WCubicSpline2d::CalculateGrad(glm::vec2 radius) {
-        glm::vec2 res(0.0f, 0.0f);
-        float distance = glm::length(radius);
-        if (distance < 1e-5) {
-            return res;
-        }
-
-        float q = distance / mH;
-        glm::vec2 qGrad = radius / (mH * distance);
-
-        if (q < 0.5f) {
-            res = 6.0f * (3.0f * q * q - 2.0f * q) * mSigma * qGrad;
-            return res;
-        }
-        else if (q >= 0.5 && q < 1.0f) {
-            res = -6.0f * std::powf(1.0f - q, 2) * mSigma * qGrad;
-            return res;
-        }
-        return res;
+    bool WCubicSpline2d::GetInterpolate() {
+        return mInterpolate;
     }
 
     WCubicSpline3d::WCubicSpline3d(float h) {
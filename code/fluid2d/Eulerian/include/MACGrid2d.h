@@ -4,14 +4,12 @@
 
 #include <windows.h>
 #include <glm/glm.hpp>
-#include "GridData2d.h"
+#include "Grid2d.h"
 
 namespace FluidSimulation
 {
     namespace Eulerian2d
     {
-        using namespace boost::numeric;
-
         enum RenderMode
         {
             NONE,
@@ -88,12 +86,12 @@ namespace FluidSimulation
             int dim[2];
 
         public:
-            Glb::GridData2dX mU;     // x
-            Glb::GridData2dY mV;     // y
-            Glb::CubicGridData2d mD; // density
-            Glb::CubicGridData2d mT; // temperature
+            Glb::Grid2d<double, Glb::Stagger2d::FaceX> mU; // x
+            Glb::Grid2d<double, Glb::Stagger2d::FaceY> mV; // y
+            Glb::Grid2d<double> mD;                        // density
+            Glb::Grid2d<double> mT;                        // temperature
 
-            Glb::GridData2d mSolid; // solid
+            Glb::Grid2d<unsigned char> mSolid; // solid
         };
 
 #define FOR_EACH_CELL                                                \
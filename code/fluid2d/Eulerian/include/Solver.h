@@ -5,13 +5,18 @@
 #pragma warning(disable: 4244 4267 4996)
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/io.hpp>
-#include <boost/numeric/ublas/matrix_sparse.hpp>
 
 #include "Eulerian/include/MACGrid2d.h"
+#include "PoissonStencil2d.h"
+#include "Multigrid2d.h"
+#include "Preconditioner2d.h"
+#include "FastPoisson2d.h"
 #include "Global.h"
 
 namespace FluidSimulation{
 	namespace Eulerian2d {
+		using namespace boost::numeric;
+
 		class Solver {
 		public:
 			Solver(MACGrid2d& grid);
@@ -19,25 +24,28 @@ namespace FluidSimulation{
 
 			virtual void solve();
 
-			void advectVelocity();
+			// շƽٶȺ/¶ȡܶ
+			void advect(bool velocity, bool scalars);
 			void addExternalForces();
 			void project();
-			void advectTemperature();
-			void advectDensity();
 
 			void constructA();
 			void constructB(unsigned int numCells);
 			void constructPrecon();
+			void updateSolids();
 
 		protected:
 			MACGrid2d& mGrid;
 
-			MACGrid2d target;   // advection׶δ洢µĳ
+			MACGrid2d target;   // ׶дµĳд mGrid 
 
-			ublas::compressed_matrix<double> A;
+			Glb::PoissonStencil2d A;
 			ublas::vector<double> b;
-			ublas::vector<double> precon;
-
+			ublas::vector<double> pressure; // һ֡ѹΪһĳֵ
+			Glb::Multigrid2d multigrid;
+			Glb::Preconditioner2d preconditioner;
+			Glb::FastPoisson2d fastPoisson;
+			bool hasSolids;
 		};
 	}
 }
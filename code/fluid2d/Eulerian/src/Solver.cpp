@@ -2,10 +2,15 @@
 #include "ConjGrad2d.h"
 #include "Configure.h"
 
+#include <chrono>
+
 namespace FluidSimulation
 {
     namespace Eulerian2d
     {
+        // rows per tile the advection sweep hands out to the threads
+        static const int ADVECT_TILE = 8;
+
         Solver::Solver(MACGrid2d &grid) : mGrid(grid)
         {
             mGrid.reset();
@@ -29,9 +34,9 @@ namespace FluidSimulation
 
             Glb::Timer::getInstance().start();
 
-            target.reset();
+            updateSolids();
 
-            advectVelocity();
+            advect(true, false);
 
             Glb::Timer::getInstance().recordTime("vel advection");
 
@@ -44,9 +49,7 @@ namespace FluidSimulation
 
             Glb::Timer::getInstance().recordTime("projection");
 
-            advectTemperature();
-
-            advectDensity();
+            advect(false, true);
 
             Glb::Timer::getInstance().recordTime("temp & density advection");
             
@@ -54,71 +57,46 @@ namespace FluidSimulation
 
         void Solver::constructA()
         {
-            unsigned int numCells = mGrid.mSolid.data().size();
-            A.resize(numCells, numCells, false);
-
-            for (unsigned int row = 0; row < numCells; row++)
+            // A is never assembled: the stencil only needs to know which cells are fluid
+            A.resize(mGrid.dim[0], mGrid.dim[1]);
+            fastPoisson.build(mGrid.dim[0], mGrid.dim[1]);
+            pressure.resize(A.size1());
+            std::fill(pressure.begin(), pressure.end(), 0.0);
+            FOR_EACH_CELL
             {
-                int ri, rj;
-                mGrid.getCell(row, ri, rj); // Each row corresponds to a cell
-                if (mGrid.isSolidCell(ri, rj))
-                    continue;
-                for (unsigned int col = 0; col < numCells; col++)
-                {
-                    int ci, cj;
-                    mGrid.getCell(col, ci, cj); // Each col corresponds to a possible neighbor
-                    if (mGrid.isSolidCell(ci, cj))
-                        continue;
-                    double coeff = mGrid.getPressureCoeffBetweenCells(ri, rj, ci, cj);
-                    if (fabs(coeff) > 0.0001)
-                    {
-                        A(row, col) = coeff;
-                    }
-                }
+                A.setFluid(i, j, !mGrid.isSolidCell(i, j));
             }
         }
 
-#define VALA(r, c) (r != -1 && c != -1) ? A(r, c) : 0
-        void Solver::constructPrecon()
+        void Solver::updateSolids()
         {
-            precon.resize(A.size1());
-            std::fill(precon.begin(), precon.end(), 0);
-
-            double tau = 0.0; // Disable MIC(0) 0.97;
-            for (unsigned int index = 0; index < A.size1(); index++)
+            // Only cells whose solid flag changed are touched. The preconditioner
+            // depends on the flags too, so it is rebuilt if any of them did.
+            bool changed = false;
+            FOR_EACH_CELL
             {
-                int i, j;
-                mGrid.getCell(index, i, j);
-                if (mGrid.isSolidCell(i, j))
-                    continue;
-
-                int neighbori = mGrid.getIndex(i - 1, j);
-                int neighborj = mGrid.getIndex(i, j - 1);
-                double termi = neighbori != -1 ? A(index, neighbori) * precon(neighbori) : 0;
-                double termj = neighborj != -1 ? A(index, neighborj) * precon(neighborj) : 0;
-
-                double termii = 0;
-                if (neighbori != -1)
+                if (A.setFluid(i, j, !mGrid.isSolidCell(i, j)))
                 {
-                    int neighborij = mGrid.getIndex(i - 1, j + 1);
-                    double termii0 = (VALA(neighbori, neighborij));
-                    double termii1 = precon(neighbori) * precon(neighbori);
-                    termii = VALA(index, neighbori) * termii0 / termii1;
+                    // a cell that changed type restarts from zero pressure
+                    pressure(mGrid.getIndex(i, j)) = 0.0;
+                    changed = true;
                 }
+            }
 
-                double termjj = 0;
-                if (neighborj != -1)
-                {
-                    int neighborji = mGrid.getIndex(i + 1, j - 1);
-                    double termjj0 = (VALA(neighborj, neighborji));
-                    double termjj1 = precon(neighborj) * precon(neighborj);
-                    termjj = VALA(index, neighborj) * termjj0 / termjj1;
-                }
+            if (changed)
+            {
+                constructPrecon();
+            }
+        }
 
-                double e = A(index, index) - termi * termi - termj * termj - tau * (termii + termjj);
+        void Solver::constructPrecon()
+        {
+            // the multigrid levels are coarsened from the same solid flags
+            multigrid.build(A);
+            preconditioner.build(A, Eulerian2dPara::preconditioner);
 
-                precon(index) = 1 / sqrt(e);
-            }
+            // the spectral solver only applies to an empty box
+            hasSolids = mGrid.numSolidCells() > 0;
         }
 
         void Solver::constructB(unsigned int numCells)
@@ -136,30 +114,69 @@ namespace FluidSimulation
             }
         }
 
-        void Solver::advectVelocity()
+        void Solver::advect(bool velocity, bool scalars)
         {
-            FOR_EACH_LINE
+            // Every sample is traced back once through the current velocity field.
+            // Temperature and density live at the same cell centers, so they share
+            // the traced point and the interpolation lookup. The grid is swept in
+            // tiles of ADVECT_TILE rows, each a run of contiguous i, and the tiles
+            // are spread over the threads.
+            int dimX = mGrid.dim[0], dimY = mGrid.dim[1];
+            int tiles = (dimY + ADVECT_TILE) / ADVECT_TILE;
+            double dt = Eulerian2dPara::dt;
+
+#pragma omp parallel for schedule(dynamic)
+            for (int tile = 0; tile < tiles; tile++)
             {
-                // advect u
-                if (mGrid.isFace(i, j, mGrid.X))
-                {
-                    glm::vec2 pos = mGrid.getLeftLine(i, j);                     
-                    glm::vec2 newpos = mGrid.traceBack(pos, Eulerian2dPara::dt);
-                    glm::vec2 newvel = mGrid.getVelocity(newpos);                
-                    target.mU(i, j) = newvel[mGrid.X];                       
-                }
-                // advect v
-                if (mGrid.isFace(i, j, mGrid.Y))
+                int j0 = tile * ADVECT_TILE;
+                int j1 = min(j0 + ADVECT_TILE, dimY + 1);
+
+                for (int j = j0; j < j1; j++)
                 {
-                    glm::vec2 pos = mGrid.getBottomLine(i, j);
-                    glm::vec2 newpos = mGrid.traceBack(pos, Eulerian2dPara::dt);
-                    glm::vec2 newvel = mGrid.getVelocity(newpos);
-                    target.mV(i, j) = newvel[mGrid.Y];
+                    // which lines of the row exist, instead of isFace() per sample
+                    bool faceX = j < dimY;
+
+                    if (velocity)
+                    {
+                        // a point inside a solid has zero velocity, as in getVelocity()
+                        for (int i = 0; i < dimX + 1; i++)
+                        {
+                            if (faceX)
+                            {
+                                glm::vec2 newpos = mGrid.traceBack(mGrid.getLeftLine(i, j), dt);
+                                target.mU(i, j) = mGrid.inSolid(newpos) ? 0.0f : (float)mGrid.getVelocityX(newpos);
+                            }
+                            if (i == dimX)
+                                break;
+                            glm::vec2 newpos = mGrid.traceBack(mGrid.getBottomLine(i, j), dt);
+                            target.mV(i, j) = mGrid.inSolid(newpos) ? 0.0f : (float)mGrid.getVelocityY(newpos);
+                        }
+                    }
+
+                    if (scalars && j < dimY)
+                    {
+                        for (int i = 0; i < dimX; i++)
+                        {
+                            glm::vec2 newpos = mGrid.traceBack(mGrid.getCenter(i, j), dt);
+                            Glb::Grid2d<double>::Location loc;
+                            mGrid.mT.locate(newpos, loc);
+                            target.mT(i, j) = mGrid.mT.interpolateCubic(loc);
+                            target.mD(i, j) = mGrid.mD.interpolateCubic(loc);
+                        }
+                    }
                 }
             }
 
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
+            if (velocity)
+            {
+                mGrid.mU.swap(target.mU);
+                mGrid.mV.swap(target.mV);
+            }
+            if (scalars)
+            {
+                mGrid.mT.swap(target.mT);
+                mGrid.mD.swap(target.mD);
+            }
         }
 
         void Solver::addExternalForces()
@@ -175,11 +192,11 @@ namespace FluidSimulation
                     target.mV(i, j) = vel;
                 }
             }
-            mGrid.mV = target.mV;
+            mGrid.mV.swap(target.mV);
             
-            Glb::GridData2d forcesX, forcesY;
-            forcesX.initialize();
-            forcesY.initialize();
+            Glb::Grid2d<double> forcesX, forcesY;
+            forcesX.initialize(mGrid.dim, mGrid.cellSize);
+            forcesY.initialize(mGrid.dim, mGrid.cellSize);
 
             FOR_EACH_CELL
             {
@@ -209,8 +226,8 @@ namespace FluidSimulation
                     target.mV(i, j) = vel;
                 }
             }
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
+            mGrid.mU.swap(target.mU);
+            mGrid.mV.swap(target.mV);
         }
 
         void Solver::project()
@@ -219,9 +236,50 @@ namespace FluidSimulation
             unsigned int numCells = Eulerian2dPara::theDim2d[0] * Eulerian2dPara::theDim2d[1];
             constructB(numCells);
 
-            ublas::vector<double> p(numCells);
+            // warm start from the previous frame's pressure
+            ublas::vector<double> &p = pressure;
+            double tol = Eulerian2dPara::pressureTolerance;
+            if (Eulerian2dPara::relativeTolerance)
+                tol *= norm_2(b);
 
-            Glb::cg_psolve2d(A, precon, b, p, 500, 0.005);
+            int iterations = 0;
+            double residual = 0.0;
+            auto solveStart = std::chrono::steady_clock::now();
+            switch (Eulerian2dPara::pressureSolver)
+            {
+            case 1:
+                // plain V-cycles can stall next to thin solids (see Multigrid2d), MG-PCG then
+                // continues from the current pressure and the V-cycles count as iterations
+                if (!multigrid.solve(b, p, 100, tol, iterations, residual))
+                {
+                    int cgIterations = 0;
+                    Glb::cg_mgsolve2d(A, multigrid, b, p, 500, tol, cgIterations, residual);
+                    iterations += cgIterations;
+                }
+                break;
+            case 3:
+                if (!hasSolids)
+                {
+                    // direct solve, the residual is only measured for the Inspector
+                    fastPoisson.solve(b, p);
+                    ublas::vector<double> r(b.size());
+                    A.residual(b, p, r, 1.0);
+                    residual = norm_2(r);
+                    break;
+                }
+                // interior solids: fall back to MG-PCG
+            case 2:
+                Glb::cg_mgsolve2d(A, multigrid, b, p, 500, tol, iterations, residual);
+                break;
+            default:
+                if (preconditioner.type != Eulerian2dPara::preconditioner)
+                    preconditioner.build(A, Eulerian2dPara::preconditioner);
+                Glb::cg_psolve2d(A, preconditioner, b, p, 500, tol, iterations, residual);
+                break;
+            }
+            Eulerian2dPara::pressureTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+            Eulerian2dPara::pressureIterations = iterations;
+            Eulerian2dPara::pressureResidual = residual;
             // Glb::cg_solve2d(A, b, p, 500, 0.005);
 
             // Subtract pressure from our velocity and save in target
@@ -266,34 +324,10 @@ namespace FluidSimulation
                 }
             }
 
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
+            mGrid.mU.swap(target.mU);
+            mGrid.mV.swap(target.mV);
             assert(mGrid.checkDivergence());
         }
 
-        void Solver::advectTemperature()
-        {
-            FOR_EACH_CELL
-            {
-                glm::vec2 pos = mGrid.getCenter(i, j);
-                glm::vec2 newpos = mGrid.traceBack(pos, Eulerian2dPara::dt);
-                double newt = mGrid.getTemperature(newpos);
-                target.mT(i, j) = newt;
-            }
-            mGrid.mT = target.mT;
-        }
-
-        void Solver::advectDensity()
-        {
-            FOR_EACH_CELL
-            {
-                glm::vec2 pos = mGrid.getCenter(i, j);
-                glm::vec2 newpos = mGrid.traceBack(pos, Eulerian2dPara::dt);
-                double newd = mGrid.getDensity(newpos);
-                target.mD(i, j) = newd;
-            }
-            mGrid.mD = target.mD;
-        }
-
     }
 }
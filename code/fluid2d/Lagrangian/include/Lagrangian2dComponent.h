@@ -33,6 +33,9 @@ namespace FluidSimulation
             virtual void init();
             virtual void simulate();
             virtual GLuint getRenderedTexture();
+
+        private:
+            double updateEmitters(float dt); // milliseconds the emitters and sinks took
         };
     }
 }
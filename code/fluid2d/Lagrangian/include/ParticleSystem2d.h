@@ -8,6 +8,7 @@
 #include "Global.h"
 
 #include "Configure.h"
+#include "CountingSort.h"
 
 namespace FluidSimulation
 {
@@ -27,6 +28,44 @@ namespace FluidSimulation
             alignas(4) uint32_t blockId;
         };
 
+        // Verlet neighbour lists in CSR form: the candidates of every particle within
+        // (1 + skin) * supportRadius. As long as no particle has moved more than half
+        // the skin since the build, they include every neighbour inside the support radius
+        struct NeighborList2d
+        {
+            std::vector<uint32_t> offsets; // the candidates of i are indices[offsets[i], offsets[i + 1])
+            std::vector<uint32_t> indices;
+            std::vector<glm::vec2> refPosition; // positions at the time of the build
+            float skin = 0.0f;
+            std::vector<std::vector<uint32_t>> threadIndices;
+
+            // filled by the density pass every substep and reused by the acceleration pass,
+            // zero beyond the support radius
+            std::vector<float> distance;
+            std::vector<glm::vec2> grad;
+
+            void clear();
+        };
+
+        // a nozzle of width size centered on center and normal to velocity, it shoots a
+        // row of particles each time the fluid has advanced one particle spacing
+        struct Emitter2d
+        {
+            glm::vec2 center;
+            glm::vec2 velocity;
+            float size;
+            float particleSpace;
+            float travel = 0.0f;  // distance the fluid advanced since the last row
+            uint64_t emitted = 0; // particles shot so far, the counter of their jitter
+        };
+
+        // the particles entering this axis-aligned box are removed
+        struct Sink2d
+        {
+            glm::vec2 lower;
+            glm::vec2 upper;
+        };
+
         class ParticleSystem2d
         {
         public:
@@ -36,7 +75,17 @@ namespace FluidSimulation
             void setContainerSize(glm::vec2 containerCorner, glm::vec2 containerSize);
             int32_t addFluidBlock(glm::vec2 corner, glm::vec2 size, glm::vec2 v0, float particleSpace);
             uint32_t getBlockIdByPosition(glm::vec2 position);
+            void addEmitter(glm::vec2 center, glm::vec2 velocity, float size, float particleSpace);
+            void addSink(glm::vec2 corner, glm::vec2 size);
+            // the particle pool: storage for capacity particles is reserved up front, the
+            // emitters only append within it and pause while it is full
+            void reserve(int capacity);
+            // removes the particles inside the sinks and shoots the particles of the next dt,
+            // returns the number shot. Removed particles are only marked, the block sort of
+            // the next updateBlockInfo() moves them to the end and cuts them off
+            int updateEmitters(float dt);
             void updateBlockInfo();
+            bool useNeighborList() const;
 
         public:
             float mSupportRadius = Lagrangian2dPara::supportRadius;
@@ -46,7 +95,7 @@ namespace FluidSimulation
             float mVolume = mParticleDiameter * mParticleDiameter;
 
             std::vector<ParticleInfo2d> mParticleInfos;
-            int mMaxNeighbors = 128;
+            NeighborList2d mNeighborList; // kept by updateBlockInfo() while Lagrangian2dPara::neighborList is on
 
             glm::vec2 mLowerBound = glm::vec2(FLT_MAX);
             glm::vec2 mUpperBound = glm::vec2(-FLT_MAX);
@@ -56,6 +105,25 @@ namespace FluidSimulation
 
             std::vector<glm::uvec2> mBlockExtens;
             std::vector<int32_t> mBlockIdOffs;
+
+            // block id of a removed particle, out of the grid's range so the block sort puts it last
+            static const uint32_t REMOVED_BLOCK_ID = 0xffffffff;
+            std::vector<Emitter2d> mEmitters;
+            std::vector<Sink2d> mSinks;
+
+        private:
+            void sortByBlock();
+            void benchmarkBlockSort();
+            bool neighborListValid() const;
+            void buildNeighborList();
+
+            Glb::CountingSort mBlockSort;
+            std::vector<uint32_t> mBlockIds;
+            std::vector<uint32_t> mSortOrder;
+            std::vector<ParticleInfo2d> mScratch;
+            int mCapacity = 0;
+            bool mRemoved = false;  // particles were marked as removed, the next updateBlockInfo() has to sort
+            bool mPoolFull = false; // the full pool has been logged
         };
     }
 }
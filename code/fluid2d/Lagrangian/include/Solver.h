@@ -12,17 +12,40 @@ namespace FluidSimulation
 
     namespace Lagrangian2d
     {
+        // the pairs j > i inside the support radius that computeDensityAndPress met on
+        // its walk over the grid, replayed by computeAccleration when
+        // Lagrangian2dPara::pairStream is set. Every thread records one stream over a
+        // contiguous range of particles
+        struct PairStream2d
+        {
+            struct Pair
+            {
+                uint32_t j;
+                float distance;
+                float gradFactor; // grad W = gradFactor * (xi - xj)
+            };
+
+            int begin;
+            int end;
+            std::vector<uint32_t> offsets; // pairs of particle begin + k are [offsets[k], offsets[k + 1])
+            std::vector<Pair> pairs;
+        };
+
         class Solver
         {
         public:
             Solver(ParticleSystem2d &ps);
             ~Solver();
 
-            void solve();
+            // one step of Lagrangian2dPara::dt, or with adaptiveTimeStep of the dt the
+            // stability criteria allow, cut so that it does not pass timeLeft. Returns the step taken
+            float solve(float timeLeft = FLT_MAX);
 
         private:
+            float adaptiveTimeStep(float timeLeft);
             void eulerIntegration();
             void computeDensityAndPress();
+            void recordPairStreams();
             void computeAccleration();
             void boundaryCondition();
             void calculateBlockId();
@@ -30,6 +53,10 @@ namespace FluidSimulation
         private:
             ParticleSystem2d &mPs;
             Glb::WCubicSpline2d mW;
+            float mDt; // step of the current solve
+            std::vector<std::vector<glm::vec2>> mThreadAcc; // per thread accelerations scattered to the j side of the pairs
+            std::vector<PairStream2d> mPairStreams;
+            bool mPairStreamsRecorded; // set by recordPairStreams, cleared once computeAccleration used them
         };
     }
 }
@@ -1,4 +1,6 @@
 #include "Lagrangian2dComponent.h"
+#include <algorithm>
+#include <chrono>
 
 namespace FluidSimulation
 {
@@ -35,7 +37,18 @@ namespace FluidSimulation
             // add a fluid block
             ps->addFluidBlock(glm::vec2(-0.4, -0.4), glm::vec2(0.8, 0.8), glm::vec2(-0.0f, -0.0f), 0.02f);
 
+            // a nozzle above the left side of the block and a drain in the right corner of the floor
+            if (Lagrangian2dPara::emitters)
+            {
+                ps->addEmitter(glm::vec2(-0.7f, 0.7f), glm::vec2(0.0f, -1.5f), 0.1f, 0.02f);
+                ps->addSink(glm::vec2(0.7f, -1.05f), glm::vec2(0.35f, 0.1f));
+            }
+
+            ps->reserve(Lagrangian2dPara::maxParticleNum);
             ps->updateBlockInfo();
+            Lagrangian2dPara::particleNum = ps->mParticleInfos.size();
+            std::fill(Lagrangian2dPara::particleNumHistory, Lagrangian2dPara::particleNumHistory + Lagrangian2dPara::PARTICLE_NUM_HISTORY, 0.0f);
+            Lagrangian2dPara::particleNumHistoryOffset = 0;
 
             std::cout << "particle num = " << ps->mParticleInfos.size() << std::endl;
 
@@ -44,11 +57,59 @@ namespace FluidSimulation
 
         void Lagrangian2dComponent::simulate()
         {
-            for (int i = 0; i < Lagrangian2dPara::substep; i++)
+            double emissionMs = 0.0;
+            if (!Lagrangian2dPara::adaptiveTimeStep)
+            {
+                for (int i = 0; i < Lagrangian2dPara::substep; i++)
+                {
+                    ps->updateBlockInfo();
+                    float dt = solver->solve();
+                    emissionMs += updateEmitters(dt);
+                }
+            }
+            else
+            {
+                // as many steps as the chosen dt needs to advance frameTime
+                float timeLeft = Lagrangian2dPara::frameTime;
+                int steps = 0;
+                while (timeLeft > 0.0f)
+                {
+                    ps->updateBlockInfo();
+                    float dt = solver->solve(timeLeft);
+                    emissionMs += updateEmitters(dt);
+                    timeLeft = dt < timeLeft ? timeLeft - dt : 0.0f;
+                    steps++;
+                }
+                Lagrangian2dPara::frameSteps = steps;
+            }
+
+            // removed particles are only cut off by the next sort, count the ones still alive
+            int particleNum = 0;
+            const std::vector<ParticleInfo2d> &particles = ps->mParticleInfos;
+#pragma omp parallel for reduction(+ : particleNum)
+            for (int i = 0; i < (int)particles.size(); i++)
+            {
+                particleNum += particles[i].blockId != ParticleSystem2d::REMOVED_BLOCK_ID;
+            }
+            Lagrangian2dPara::particleNum = particleNum;
+            Lagrangian2dPara::emissionTime = emissionMs;
+            int &offset = Lagrangian2dPara::particleNumHistoryOffset;
+            Lagrangian2dPara::particleNumHistory[offset] = particleNum;
+            offset = (offset + 1) % Lagrangian2dPara::PARTICLE_NUM_HISTORY;
+        }
+
+        double Lagrangian2dComponent::updateEmitters(float dt)
+        {
+            if (ps->mEmitters.empty() && ps->mSinks.empty())
             {
-                ps->updateBlockInfo();
-                solver->solve();
+                return 0.0;
             }
+            Glb::Timer::getInstance().start();
+            auto start = std::chrono::steady_clock::now();
+            ps->updateEmitters(dt);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            Glb::Timer::getInstance().recordTime("emitters and sinks");
+            return ms;
         }
 
         GLuint Lagrangian2dComponent::getRenderedTexture()
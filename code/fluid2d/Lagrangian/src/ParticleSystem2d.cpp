@@ -2,12 +2,26 @@
 #include <iostream>
 #include "Global.h"
 #include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "Logger.h"
+#include <omp.h>
 
 namespace FluidSimulation
 {
 
     namespace Lagrangian2d
     {
+        void NeighborList2d::clear()
+        {
+            offsets.clear();
+            indices.clear();
+            refPosition.clear();
+            distance.clear();
+            grad.clear();
+        }
+
         ParticleSystem2d::ParticleSystem2d()
         {
         }
@@ -42,6 +56,10 @@ namespace FluidSimulation
             }
 
             mParticleInfos.clear();
+            mNeighborList.clear();
+            mEmitters.clear();
+            mSinks.clear();
+            mRemoved = false;
         }
 
         int ParticleSystem2d::addFluidBlock(glm::vec2 corner, glm::vec2 size, glm::vec2 v0, float particleSpace)
@@ -64,26 +82,137 @@ namespace FluidSimulation
             glm::uvec2 particleNum = glm::uvec2(size.x / particleSpace, size.y / particleSpace);
             std::vector<ParticleInfo2d> particles(particleNum.x * particleNum.y);
 
-            Glb::RandomGenerator rand;
-            int p = 0;
-            for (int idX = 0; idX < particleNum.x; idX++)
+            // the jitter of a particle only depends on the seed and its index in the scene,
+            // so the block is filled in parallel and a seed always gives the same scene
+            Glb::CounterRandom rand(Lagrangian2dPara::seed);
+            uint64_t first = mParticleInfos.size();
+            int blockParticleNum = particles.size();
+#pragma omp parallel for
+            for (int p = 0; p < blockParticleNum; p++)
             {
-                for (int idY = 0; idY < particleNum.y; idY++)
-                {
-                    float x = (idX + rand.GetUniformRandom()) * particleSpace;
-                    float y = (idY + rand.GetUniformRandom()) * particleSpace;
+                int idX = p / particleNum.y;
+                int idY = p % particleNum.y;
+                float x = (idX + rand.GetUniform(2 * (first + p))) * particleSpace;
+                float y = (idY + rand.GetUniform(2 * (first + p) + 1)) * particleSpace;
 
-                    particles[p].position = corner + glm::vec2(x, y);
-                    particles[p].blockId = getBlockIdByPosition(particles[p].position);
-                    particles[p].velocity = v0;
-                    p++;
-                }
+                particles[p].position = corner + glm::vec2(x, y);
+                particles[p].blockId = getBlockIdByPosition(particles[p].position);
+                particles[p].velocity = v0;
             }
 
             mParticleInfos.insert(mParticleInfos.end(), particles.begin(), particles.end());
             return particles.size();
         }
 
+        void ParticleSystem2d::addEmitter(glm::vec2 center, glm::vec2 velocity, float size, float particleSpace)
+        {
+            if (glm::length(velocity) <= 0.0f)
+            {
+                return;
+            }
+            Emitter2d emitter;
+            emitter.center = center * Lagrangian2dPara::scale;
+            emitter.velocity = velocity;
+            emitter.size = size * Lagrangian2dPara::scale;
+            emitter.particleSpace = particleSpace;
+            mEmitters.push_back(emitter);
+        }
+
+        void ParticleSystem2d::addSink(glm::vec2 corner, glm::vec2 size)
+        {
+            Sink2d sink;
+            sink.lower = corner * Lagrangian2dPara::scale;
+            sink.upper = sink.lower + size * Lagrangian2dPara::scale;
+            mSinks.push_back(sink);
+        }
+
+        void ParticleSystem2d::reserve(int capacity)
+        {
+            // the block sort swaps the particles with the scratch buffer, both need the capacity
+            mCapacity = max(capacity, (int)mParticleInfos.size());
+            mParticleInfos.reserve(mCapacity);
+            mScratch.reserve(mCapacity);
+            mBlockIds.reserve(mCapacity);
+            mSortOrder.reserve(mCapacity);
+        }
+
+        int ParticleSystem2d::updateEmitters(float dt)
+        {
+            // sinks only mark their particles, the block sort that runs anyway drops them
+            int sinkNum = mSinks.size();
+            if (sinkNum > 0)
+            {
+                int particleNum = mParticleInfos.size();
+                int removed = 0;
+#pragma omp parallel for reduction(+ : removed)
+                for (int i = 0; i < particleNum; i++)
+                {
+                    ParticleInfo2d &particle = mParticleInfos[i];
+                    for (int s = 0; s < sinkNum && particle.blockId != REMOVED_BLOCK_ID; s++)
+                    {
+                        if (glm::all(glm::greaterThanEqual(particle.position, mSinks[s].lower)) &&
+                            glm::all(glm::lessThanEqual(particle.position, mSinks[s].upper)))
+                        {
+                            particle.blockId = REMOVED_BLOCK_ID;
+                            removed++;
+                        }
+                    }
+                }
+                mRemoved = mRemoved || removed > 0;
+            }
+
+            // new particles are appended, the next block sort moves them into their blocks
+            int emitted = 0;
+            for (int e = 0; e < mEmitters.size(); e++)
+            {
+                Emitter2d &emitter = mEmitters[e];
+                float speed = glm::length(emitter.velocity);
+                glm::vec2 direction = emitter.velocity / speed;
+                glm::vec2 tangent = glm::vec2(-direction.y, direction.x);
+                int rowNum = max((int)(emitter.size / emitter.particleSpace), 1);
+
+                // every emitter draws its jitter from its own counter range, apart from addFluidBlock's
+                Glb::CounterRandom rand(Lagrangian2dPara::seed);
+                uint64_t counterBase = (uint64_t)(e + 1) << 40;
+
+                emitter.travel += speed * dt;
+                while (emitter.travel >= emitter.particleSpace)
+                {
+                    emitter.travel -= emitter.particleSpace;
+                    int first = mParticleInfos.size();
+                    if (first + rowNum > mCapacity)
+                    {
+                        // drop the inflow of this step rather than grow the arrays
+                        emitter.travel = 0.0f;
+                        if (!mPoolFull)
+                        {
+                            char message[128];
+                            snprintf(message, sizeof(message), "Particle pool full (%d particles), emitters paused", mCapacity);
+                            Glb::Logger::getInstance().addLog(message);
+                            mPoolFull = true;
+                        }
+                        break;
+                    }
+                    mPoolFull = false;
+
+                    // the row was shot travel ago and has moved that far along the velocity
+                    mParticleInfos.resize(first + rowNum);
+                    for (int n = 0; n < rowNum; n++)
+                    {
+                        float u = ((n + 0.5f) / rowNum - 0.5f) * emitter.size +
+                                  rand.GetUniform(counterBase + emitter.emitted + n, -0.05f, 0.05f) * emitter.particleSpace;
+                        ParticleInfo2d &particle = mParticleInfos[first + n];
+                        particle.position = emitter.center + u * tangent + emitter.travel * direction;
+                        particle.velocity = emitter.velocity;
+                        particle.blockId = getBlockIdByPosition(particle.position);
+                    }
+                    emitter.emitted += rowNum;
+                    emitted += rowNum;
+                }
+            }
+            return emitted;
+        }
+
         uint32_t ParticleSystem2d::getBlockIdByPosition(glm::vec2 position)
         {
             if (position.x < mLowerBound.x ||
@@ -102,26 +231,204 @@ namespace FluidSimulation
 
         void ParticleSystem2d::updateBlockInfo()
         {
-            std::sort(mParticleInfos.begin(), mParticleInfos.end(),
-                      [=](ParticleInfo2d &first, ParticleInfo2d &second)
-                      {
-                          return first.blockId < second.blockId;
-                      });
+            if (Lagrangian2dPara::benchmarkBlockSort)
+            {
+                Lagrangian2dPara::benchmarkBlockSort = false;
+                benchmarkBlockSort();
+            }
+
+            // the particles keep their order while the neighbour lists are valid. Removed
+            // particles force a sort, emitted ones change the count and invalidate the lists
+            if (!Lagrangian2dPara::neighborList)
+            {
+                mNeighborList.clear();
+            }
+            else if (!mRemoved && neighborListValid())
+            {
+                return;
+            }
+
+            // block ids are small bounded integers: a parallel counting sort gives the
+            // permutation and the [begin, end) range of every block in one pass
+            sortByBlock();
 
-            mBlockExtens = std::vector<glm::uvec2>(mBlockNum.x * mBlockNum.y, glm::uvec2(0, 0));
-            int curBlockId = 0;
-            int left = 0;
-            int right;
-            for (right = 0; right < mParticleInfos.size(); right++)
+            if (Lagrangian2dPara::neighborList)
             {
-                if (mParticleInfos[right].blockId != curBlockId)
+                buildNeighborList();
+            }
+        }
+
+        bool ParticleSystem2d::useNeighborList() const
+        {
+            return Lagrangian2dPara::neighborList && mNeighborList.offsets.size() == mParticleInfos.size() + 1;
+        }
+
+        bool ParticleSystem2d::neighborListValid() const
+        {
+            const NeighborList2d &list = mNeighborList;
+            int particleNum = mParticleInfos.size();
+            if (list.offsets.size() != particleNum + 1 || list.skin != Lagrangian2dPara::neighborSkin)
+            {
+                return false;
+            }
+
+            // beyond half the skin two particles may have closed in from outside the candidate radius
+            float limit = 0.5f * list.skin * mSupportRadius;
+            float limit2 = limit * limit;
+            bool valid = true;
+#pragma omp parallel for reduction(&& : valid)
+            for (int i = 0; i < particleNum; i++)
+            {
+                glm::vec2 move = mParticleInfos[i].position - list.refPosition[i];
+                valid = valid && glm::dot(move, move) <= limit2;
+            }
+            return valid;
+        }
+
+        void ParticleSystem2d::buildNeighborList()
+        {
+            // the particles are sorted by block. The candidate radius is larger than a
+            // block, so every particle scans the blocks its candidate disc overlaps
+            NeighborList2d &list = mNeighborList;
+            int particleNum = mParticleInfos.size();
+            list.skin = Lagrangian2dPara::neighborSkin;
+            float radius = mSupportRadius * (1.0f + list.skin);
+            float radius2 = radius * radius;
+            glm::ivec2 maxCell = glm::ivec2(mBlockNum) - 1;
+
+            // each thread lists a contiguous range of particles into its own buffer,
+            // which is copied into place once the offsets are known
+            list.offsets.resize(particleNum + 1);
+            list.offsets[0] = 0;
+            list.threadIndices.resize(omp_get_max_threads());
+#pragma omp parallel
+            {
+                int thread = omp_get_thread_num();
+                int threadNum = omp_get_num_threads();
+                int begin = (long long)particleNum * thread / threadNum;
+                int end = (long long)particleNum * (thread + 1) / threadNum;
+                std::vector<uint32_t> &indices = list.threadIndices[thread];
+                indices.clear();
+                for (int i = begin; i < end; i++)
+                {
+                    glm::vec2 positionI = mParticleInfos[i].position;
+                    glm::ivec2 lower = glm::clamp(glm::ivec2(glm::floor((positionI - radius - mLowerBound) / mBlockSize)), glm::ivec2(0), maxCell);
+                    glm::ivec2 upper = glm::clamp(glm::ivec2(glm::floor((positionI + radius - mLowerBound) / mBlockSize)), glm::ivec2(0), maxCell);
+                    uint32_t count = indices.size();
+                    for (int r = lower.y; r <= upper.y; r++)
+                    {
+                        for (int c = lower.x; c <= upper.x; c++)
+                        {
+                            glm::uvec2 extent = mBlockExtens[r * mBlockNum.x + c];
+                            for (int j = extent.x; j < extent.y; j++)
+                            {
+                                glm::vec2 radiusIj = positionI - mParticleInfos[j].position;
+                                if (j != i && glm::dot(radiusIj, radiusIj) <= radius2)
+                                {
+                                    indices.push_back(j);
+                                }
+                            }
+                        }
+                    }
+                    list.offsets[i + 1] = indices.size() - count;
+                }
+
+#pragma omp barrier
+#pragma omp single
+                {
+                    for (int i = 0; i < particleNum; i++)
+                    {
+                        list.offsets[i + 1] += list.offsets[i];
+                    }
+                    list.indices.resize(list.offsets[particleNum]);
+                    list.distance.resize(list.indices.size());
+                    list.grad.resize(list.indices.size());
+                    list.refPosition.resize(particleNum);
+                }
+
+                std::copy(indices.begin(), indices.end(), list.indices.begin() + list.offsets[begin]);
+                for (int i = begin; i < end; i++)
                 {
-                    mBlockExtens[curBlockId] = glm::uvec2(left, right); // ����ҿ�
-                    left = right;
-                    curBlockId = mParticleInfos[right].blockId;
+                    list.refPosition[i] = mParticleInfos[i].position;
                 }
             }
-            mBlockExtens[curBlockId] = glm::uvec2(left, right);
+        }
+
+        void ParticleSystem2d::sortByBlock()
+        {
+            int particleNum = mParticleInfos.size();
+            mBlockIds.resize(particleNum);
+#pragma omp parallel for
+            for (int i = 0; i < particleNum; i++)
+            {
+                mBlockIds[i] = mParticleInfos[i].blockId;
+            }
+            int blockNum = mBlockNum.x * mBlockNum.y;
+            mBlockSort.sort(mBlockIds, blockNum, Lagrangian2dPara::threads, mSortOrder, mBlockExtens);
+
+            // particles with a block id out of range, the removed ones and any outside the
+            // container, sort after the last block: the gather leaves them out, which
+            // compacts the pool without a pass of its own
+            int aliveNum = blockNum > 0 ? mBlockExtens[blockNum - 1].y : 0;
+            mScratch.resize(aliveNum);
+#pragma omp parallel for
+            for (int i = 0; i < aliveNum; i++)
+            {
+                mScratch[i] = mParticleInfos[mSortOrder[i]];
+            }
+            mParticleInfos.swap(mScratch);
+            mRemoved = false;
+        }
+
+        void ParticleSystem2d::benchmarkBlockSort()
+        {
+            // times both sorts on copies of the current particles. The counting sort runs the
+            // steps of sortByBlock() on local buffers, so neither the particle pool, its
+            // capacity nor mRemoved changes
+            const int repeats = 10;
+            const std::vector<ParticleInfo2d> &particles = mParticleInfos;
+            int particleNum = particles.size();
+            int blockNum = mBlockNum.x * mBlockNum.y;
+            std::vector<ParticleInfo2d> sorted;
+            std::vector<uint32_t> blockIds(particleNum);
+            std::vector<uint32_t> order;
+            std::vector<glm::uvec2> extents;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++)
+            {
+                sorted = particles;
+                std::sort(sorted.begin(), sorted.end(),
+                          [=](ParticleInfo2d &first, ParticleInfo2d &second)
+                          {
+                              return first.blockId < second.blockId;
+                          });
+            }
+            auto mid = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++)
+            {
+#pragma omp parallel for
+                for (int i = 0; i < particleNum; i++)
+                {
+                    blockIds[i] = particles[i].blockId;
+                }
+                mBlockSort.sort(blockIds, blockNum, Lagrangian2dPara::threads, order, extents);
+                int aliveNum = blockNum > 0 ? extents[blockNum - 1].y : 0;
+                sorted.resize(aliveNum);
+#pragma omp parallel for
+                for (int i = 0; i < aliveNum; i++)
+                {
+                    sorted[i] = particles[order[i]];
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            double comparisonMs = std::chrono::duration<double, std::milli>(mid - start).count() / repeats;
+            double countingMs = std::chrono::duration<double, std::milli>(end - mid).count() / repeats;
+            char message[256];
+            snprintf(message, sizeof(message), "Block sort, %d particles in %d blocks: std::sort %.3f ms, counting sort %.3f ms",
+                     particleNum, blockNum, comparisonMs, countingMs);
+            Glb::Logger::getInstance().addLog(message);
         }
 
     }
@@ -2,13 +2,24 @@
 #include "Global.h"
 #include <iostream>
 #include <algorithm>
+#include <omp.h>
 
 namespace FluidSimulation
 {
 
     namespace Lagrangian2d
     {
-        Solver::Solver(ParticleSystem2d &ps) : mPs(ps), mW(ps.mSupportRadius)
+        // threads of the per-particle loops, Lagrangian2dPara::threads or every core
+        static int numThreads()
+        {
+            return Lagrangian2dPara::threads > 0 ? Lagrangian2dPara::threads : omp_get_max_threads();
+        }
+
+        // particles per chunk handed out to a thread, neighbour counts vary a lot
+        // between the inside and the surface of the fluid so the chunks are dynamic
+        static const int PARTICLE_CHUNK = 64;
+
+        Solver::Solver(ParticleSystem2d &ps) : mPs(ps), mW(Lagrangian2dPara::supportRadius, Lagrangian2dPara::kernelInterpolation), mDt(Lagrangian2dPara::dt), mPairStreamsRecorded(false)
         {
         }
 
@@ -16,7 +27,7 @@ namespace FluidSimulation
         {
         }
 
-        void Solver::solve()
+        float Solver::solve(float timeLeft)
         {
             // TODO
             // Solves the fluid simulation by performing some steps, which may include:
@@ -28,80 +39,242 @@ namespace FluidSimulation
             // 6. update block id
             // ...
 
+            // the kernel follows the cutoff the neighbour loops use
+            if (mW.GetH() != Lagrangian2dPara::supportRadius || mW.GetInterpolate() != Lagrangian2dPara::kernelInterpolation)
+            {
+                mW = Glb::WCubicSpline2d(Lagrangian2dPara::supportRadius, Lagrangian2dPara::kernelInterpolation);
+            }
+
             Glb::Timer::getInstance().start();
             computeDensityAndPress();
             Glb::Timer::getInstance().recordTime("density and press");
             computeAccleration();
             Glb::Timer::getInstance().recordTime("compute acc");
+            mDt = Lagrangian2dPara::adaptiveTimeStep ? adaptiveTimeStep(timeLeft) : Lagrangian2dPara::dt;
             eulerIntegration();
             Glb::Timer::getInstance().recordTime("euler intergration");
             boundaryCondition();
             Glb::Timer::getInstance().recordTime("boundary check");
             calculateBlockId();
             Glb::Timer::getInstance().recordTime("renew block id");
+            return mDt;
+        }
+
+        float Solver::adaptiveTimeStep(float timeLeft)
+        {
+            // the largest step the fastest and the most accelerated particle allow:
+            //   CFL:       dt <= cflNumber * h / max|v|
+            //   force:     dt <= 0.25 * sqrt(h / max|a|)
+            //   viscosity: dt <= 0.125 * h^2 / viscosity
+            // clamped to [minDt, maxDt]; the per-thread maxima are merged once
+            int particleNum = mPs.mParticleInfos.size();
+            float maxVelocity2 = 0.0f;
+            float maxAccleration2 = 0.0f;
+#pragma omp parallel num_threads(numThreads())
+            {
+                float velocity2 = 0.0f;
+                float accleration2 = 0.0f;
+#pragma omp for
+                for (int i = 0; i < particleNum; i++)
+                {
+                    const ParticleInfo2d &particle = mPs.mParticleInfos[i];
+                    velocity2 = max(velocity2, glm::dot(particle.velocity, particle.velocity));
+                    accleration2 = max(accleration2, glm::dot(particle.accleration, particle.accleration));
+                }
+#pragma omp critical
+                {
+                    maxVelocity2 = max(maxVelocity2, velocity2);
+                    maxAccleration2 = max(maxAccleration2, accleration2);
+                }
+            }
+
+            float h = Lagrangian2dPara::supportRadius;
+            float dt = Lagrangian2dPara::maxDt;
+            if (maxVelocity2 > 0.0f)
+            {
+                dt = min(dt, Lagrangian2dPara::cflNumber * h / sqrt(maxVelocity2));
+            }
+            if (maxAccleration2 > 0.0f)
+            {
+                dt = min(dt, 0.25f * sqrt(h / sqrt(maxAccleration2)));
+            }
+            if (Lagrangian2dPara::viscosity > 0.0f)
+            {
+                dt = min(dt, 0.125f * h * h / Lagrangian2dPara::viscosity);
+            }
+            dt = max(dt, Lagrangian2dPara::minDt);
+            Lagrangian2dPara::stepDt = dt;
+
+            // end exactly on the frame, and split the remainder evenly rather than leave a sliver
+            if (timeLeft <= dt)
+            {
+                return timeLeft;
+            }
+            if (timeLeft < 2.0f * dt)
+            {
+                return 0.5f * timeLeft;
+            }
+            return dt;
         }
 
         void Solver::computeAccleration()
         {
+            // every pair is evaluated once, from the side of its lower index i. The
+            // viscosity and pressure terms of j only differ from those of i in sign and
+            // in the density factor, so i sums its share locally and j's share goes to
+            // the buffer of the thread. The chunks are handed out statically and the
+            // buffers are added in thread order, so a given thread count always gives
+            // the same result
+            NeighborList2d &list = mPs.mNeighborList;
+            bool useList = mPs.useNeighborList();
+            bool useStreams = mPairStreamsRecorded;
+            mPairStreamsRecorded = false;
             float dim = 2.0;
             float constFactor = 2.0 * (dim + 2.0) * Lagrangian2dPara::viscosity;
-            for (int i = 0; i < mPs.mParticleInfos.size(); i++)
+            float viscosityFactor = constFactor * Lagrangian2dPara::density * mPs.mVolume;
+            float pressureFactor = mPs.mVolume;
+            float denomEps = 0.01 * Lagrangian2dPara::supportRadius * Lagrangian2dPara::supportRadius;
+            int particleNum = mPs.mParticleInfos.size();
+            int threadNum = numThreads();
+            int usedThreads = 1;
+            int streamNum = mPairStreams.size();
+            if (mThreadAcc.size() < threadNum)
             {
+                mThreadAcc.resize(threadNum);
+            }
+#pragma omp parallel num_threads(threadNum)
+            {
+#pragma omp master
+                usedThreads = omp_get_num_threads();
 
-                mPs.mParticleInfos[i].accleration = -glm::vec2(Lagrangian2dPara::gravityX, Lagrangian2dPara::gravityY);
-                glm::vec2 viscosityForce = glm::vec2(0.0);
-                glm::vec2 pressureForce = glm::vec2(0.0);
-                for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
+                int thread = omp_get_thread_num();
+                std::vector<glm::vec2> &acc = mThreadAcc[thread];
+                acc.assign(particleNum, glm::vec2(0.0f));
+                if (useStreams)
                 {
-                    int bIdj = mPs.mParticleInfos[i].blockId + mPs.mBlockIdOffs[k];
-
-                    if (bIdj >= 0 && bIdj < mPs.mBlockExtens.size())
+                    // every thread replays the stream it recorded, so the pairs are still in its cache
+                    for (int t = thread; t < streamNum; t += omp_get_num_threads())
                     {
-                        for (int j = mPs.mBlockExtens[bIdj].x; j < mPs.mBlockExtens[bIdj].y; j++)
+                        const PairStream2d &stream = mPairStreams[t];
+                        for (int i = stream.begin; i < stream.end; i++)
                         {
-                            if (j == i)
+                            const ParticleInfo2d &pi = mPs.mParticleInfos[i];
+                            glm::vec2 accI = glm::vec2(0.0f);
+                            int first = stream.offsets[i - stream.begin];
+                            int last = stream.offsets[i - stream.begin + 1];
+                            for (int e = first; e < last; e++)
                             {
-                                continue;
+                                const PairStream2d::Pair &pair = stream.pairs[e];
+                                int j = pair.j;
+                                const ParticleInfo2d &pj = mPs.mParticleInfos[j];
+                                glm::vec2 radiusIj = pi.position - pj.position;
+                                float dotDvToRad = glm::dot(pi.velocity - pj.velocity, radiusIj);
+                                float denom = pair.distance * pair.distance + denomEps;
+                                glm::vec2 wGrad = pair.gradFactor * radiusIj;
+                                glm::vec2 viscosity = viscosityFactor * dotDvToRad * wGrad / denom;
+                                glm::vec2 pressure = pressureFactor * (pi.pressDivDens2 + pj.pressDivDens2) * wGrad;
+                                accI += viscosity / pj.density - pressure * pj.density;
+                                acc[j] -= viscosity / pi.density - pressure * pi.density;
                             }
-                            glm::vec2 radiusIj = mPs.mParticleInfos[i].position - mPs.mParticleInfos[j].position;
-                            float diatanceIj = length(radiusIj);
-                            if (diatanceIj <= Lagrangian2dPara::supportRadius)
+                            acc[i] += accI;
+                        }
+                    }
+                }
+                else
+                {
+#pragma omp for schedule(static, PARTICLE_CHUNK)
+                    for (int i = 0; i < particleNum; i++)
+                    {
+                        const ParticleInfo2d &pi = mPs.mParticleInfos[i];
+                        glm::vec2 accI = glm::vec2(0.0f);
+                        if (useList)
+                        {
+                            // the distances and kernel gradients were stored by computeDensityAndPress
+                            for (int e = list.offsets[i]; e < list.offsets[i + 1]; e++)
                             {
-                                float dotDvToRad = glm::dot(mPs.mParticleInfos[i].velocity - mPs.mParticleInfos[j].velocity, radiusIj);
-                                float denom = diatanceIj * diatanceIj + 0.01 * Lagrangian2dPara::supportRadius * Lagrangian2dPara::supportRadius;
-                                glm::vec2 wGrad = mW.Grad(radiusIj);
-                                // std::cout << wGrad.x << " " << wGrad.y<< std::endl;
-                                viscosityForce += (Lagrangian2dPara::density * mPs.mVolume / mPs.mParticleInfos[j].density) * dotDvToRad * wGrad / denom;
-                                pressureForce += mPs.mParticleInfos[j].density * (mPs.mParticleInfos[i].pressDivDens2 + mPs.mParticleInfos[j].pressDivDens2) * wGrad;
+                                int j = list.indices[e];
+                                float diatanceIj = list.distance[e];
+                                if (j > i && diatanceIj <= Lagrangian2dPara::supportRadius)
+                                {
+                                    const ParticleInfo2d &pj = mPs.mParticleInfos[j];
+                                    glm::vec2 radiusIj = pi.position - pj.position;
+                                    float dotDvToRad = glm::dot(pi.velocity - pj.velocity, radiusIj);
+                                    float denom = diatanceIj * diatanceIj + denomEps;
+                                    glm::vec2 wGrad = list.grad[e];
+                                    glm::vec2 viscosity = viscosityFactor * dotDvToRad * wGrad / denom;
+                                    glm::vec2 pressure = pressureFactor * (pi.pressDivDens2 + pj.pressDivDens2) * wGrad;
+                                    accI += viscosity / pj.density - pressure * pj.density;
+                                    acc[j] -= viscosity / pi.density - pressure * pi.density;
+                                }
                             }
                         }
+                        else
+                        {
+                            for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
+                            {
+                                int bIdj = pi.blockId + mPs.mBlockIdOffs[k];
+                                if (bIdj < 0 || bIdj >= mPs.mBlockExtens.size() || mPs.mBlockExtens[bIdj].y <= i + 1)
+                                {
+                                    continue;
+                                }
+                                for (int j = max((int)mPs.mBlockExtens[bIdj].x, i + 1); j < mPs.mBlockExtens[bIdj].y; j++)
+                                {
+                                    const ParticleInfo2d &pj = mPs.mParticleInfos[j];
+                                    glm::vec2 radiusIj = pi.position - pj.position;
+                                    float diatanceIj = length(radiusIj);
+                                    if (diatanceIj <= Lagrangian2dPara::supportRadius)
+                                    {
+                                        float dotDvToRad = glm::dot(pi.velocity - pj.velocity, radiusIj);
+                                        float denom = diatanceIj * diatanceIj + denomEps;
+                                        glm::vec2 wGrad = mW.Grad(radiusIj, diatanceIj);
+                                        glm::vec2 viscosity = viscosityFactor * dotDvToRad * wGrad / denom;
+                                        glm::vec2 pressure = pressureFactor * (pi.pressDivDens2 + pj.pressDivDens2) * wGrad;
+                                        accI += viscosity / pj.density - pressure * pj.density;
+                                        acc[j] -= viscosity / pi.density - pressure * pi.density;
+                                    }
+                                }
+                            }
+                        }
+                        acc[i] += accI;
                     }
                 }
-                mPs.mParticleInfos[i].accleration += viscosityForce * constFactor;
-                mPs.mParticleInfos[i].accleration -= pressureForce * mPs.mVolume;
+            }
+
+            glm::vec2 gravity = -glm::vec2(Lagrangian2dPara::gravityX, Lagrangian2dPara::gravityY);
+#pragma omp parallel for num_threads(threadNum)
+            for (int i = 0; i < particleNum; i++)
+            {
+                glm::vec2 accleration = gravity;
+                for (int t = 0; t < usedThreads; t++)
+                {
+                    accleration += mThreadAcc[t][i];
+                }
+                mPs.mParticleInfos[i].accleration = accleration;
             }
         }
 
         void Solver::eulerIntegration()
         {
-#pragma omp parallel for
-            for (int i = 0; i < mPs.mParticleInfos.size(); i++)
+            int particleNum = mPs.mParticleInfos.size();
+#pragma omp parallel for num_threads(numThreads())
+            for (int i = 0; i < particleNum; i++)
             {
-                mPs.mParticleInfos[i].velocity = mPs.mParticleInfos[i].velocity + (float)Lagrangian2dPara::dt * mPs.mParticleInfos[i].accleration;
+                mPs.mParticleInfos[i].velocity = mPs.mParticleInfos[i].velocity + mDt * mPs.mParticleInfos[i].accleration;
                 glm::vec2 newVelocity;
                 for (int j = 0; j < 2; j++)
                 {
                     newVelocity[j] = max(-Lagrangian2dPara::maxVelocity, min(mPs.mParticleInfos[i].velocity[j], Lagrangian2dPara::maxVelocity));
                 }
                 mPs.mParticleInfos[i].velocity = newVelocity;
-                mPs.mParticleInfos[i].position = mPs.mParticleInfos[i].position + (float)Lagrangian2dPara::dt * mPs.mParticleInfos[i].velocity;
+                mPs.mParticleInfos[i].position = mPs.mParticleInfos[i].position + mDt * mPs.mParticleInfos[i].velocity;
             }
         }
 
         void Solver::boundaryCondition()
         {
-#pragma omp parallel for
-            for (int i = 0; i < mPs.mParticleInfos.size(); i++)
+            int particleNum = mPs.mParticleInfos.size();
+#pragma omp parallel for num_threads(numThreads())
+            for (int i = 0; i < particleNum; i++)
             {
 
                 bool invFlag = false;
@@ -148,7 +321,9 @@ namespace FluidSimulation
 
         void Solver::calculateBlockId()
         {
-            for (int i = 0; i < mPs.mParticleInfos.size(); i++)
+            int particleNum = mPs.mParticleInfos.size();
+#pragma omp parallel for num_threads(numThreads())
+            for (int i = 0; i < particleNum; i++)
             {
                 glm::vec2 deltePos = mPs.mParticleInfos[i].position - mPs.mLowerBound;
                 glm::vec2 blockPosition = glm::floor(deltePos / mPs.mBlockSize);
@@ -158,34 +333,125 @@ namespace FluidSimulation
 
         void Solver::computeDensityAndPress()
         {
-            for (int i = 0; i < mPs.mParticleInfos.size(); i++)
+            // each particle gathers from its neighbours and only writes itself
+            NeighborList2d &list = mPs.mNeighborList;
+            bool useList = mPs.useNeighborList();
+            if (!useList && Lagrangian2dPara::pairStream)
             {
-                for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
-                { // for all neighbor block
-                    int bIdj = mPs.mParticleInfos[i].blockId + mPs.mBlockIdOffs[k];
-                    if (bIdj >= 0 && bIdj < mPs.mBlockExtens.size())
+                recordPairStreams();
+                return;
+            }
+
+            int particleNum = mPs.mParticleInfos.size();
+#pragma omp parallel for schedule(dynamic, PARTICLE_CHUNK) num_threads(numThreads())
+            for (int i = 0; i < particleNum; i++)
+            {
+                float density = 0.0f;
+                if (useList)
+                {
+                    // one distance and kernel evaluation per pair and substep, shared with computeAccleration
+                    for (int e = list.offsets[i]; e < list.offsets[i + 1]; e++)
                     {
+                        glm::vec2 radiusIj = mPs.mParticleInfos[i].position - mPs.mParticleInfos[list.indices[e]].position;
+                        float diatanceIj = length(radiusIj);
+                        glm::vec2 grad = glm::vec2(0.0f);
+                        if (diatanceIj <= Lagrangian2dPara::supportRadius)
+                        {
+                            glm::vec2 kernel = mW.ValueAndGradFactor(diatanceIj);
+                            density += kernel.x;
+                            grad = kernel.y * radiusIj;
+                        }
+                        list.distance[e] = diatanceIj;
+                        list.grad[e] = grad;
+                    }
+                }
+                else
+                {
+                    for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
+                    { // for all neighbor block
+                        int bIdj = mPs.mParticleInfos[i].blockId + mPs.mBlockIdOffs[k];
+                        if (bIdj >= 0 && bIdj < mPs.mBlockExtens.size())
+                        {
+                            for (int j = mPs.mBlockExtens[bIdj].x; j < mPs.mBlockExtens[bIdj].y; j++)
+                            { // for all neighbor particles
+                                if (j == i)
+                                {
+                                    continue;
+                                }
+                                glm::vec2 radiusIj = mPs.mParticleInfos[i].position - mPs.mParticleInfos[j].position;
+                                float diatanceIj = length(radiusIj);
+                                if (diatanceIj <= Lagrangian2dPara::supportRadius)
+                                {
+                                    density += mW.Value(diatanceIj);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                density *= (mPs.mVolume * Lagrangian2dPara::density);
+                mPs.mParticleInfos[i].density = max(density, Lagrangian2dPara::density);
+                mPs.mParticleInfos[i].pressure = Lagrangian2dPara::stiffness * (std::powf(mPs.mParticleInfos[i].density / Lagrangian2dPara::density, Lagrangian2dPara::exponent) - 1.0);
+                mPs.mParticleInfos[i].pressDivDens2 = mPs.mParticleInfos[i].pressure / std::powf(mPs.mParticleInfos[i].density, 2);
+            }
+        }
+
+        void Solver::recordPairStreams()
+        {
+            // the density walk of the grid, recording the pairs j > i on the way. The
+            // streams follow the particle order, which follows the blocks, so a thread's
+            // range is a compact region of space
+            int particleNum = mPs.mParticleInfos.size();
+#pragma omp parallel num_threads(numThreads())
+            {
+#pragma omp single
+                mPairStreams.resize(omp_get_num_threads());
+
+                PairStream2d &stream = mPairStreams[omp_get_thread_num()];
+                stream.begin = (long long)particleNum * omp_get_thread_num() / omp_get_num_threads();
+                stream.end = (long long)particleNum * (omp_get_thread_num() + 1) / omp_get_num_threads();
+                stream.offsets.resize(stream.end - stream.begin + 1);
+                stream.offsets[0] = 0;
+                stream.pairs.clear();
+                for (int i = stream.begin; i < stream.end; i++)
+                {
+                    ParticleInfo2d &pi = mPs.mParticleInfos[i];
+                    float density = 0.0f;
+                    for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
+                    {
+                        int bIdj = pi.blockId + mPs.mBlockIdOffs[k];
+                        if (bIdj < 0 || bIdj >= mPs.mBlockExtens.size())
+                        {
+                            continue;
+                        }
                         for (int j = mPs.mBlockExtens[bIdj].x; j < mPs.mBlockExtens[bIdj].y; j++)
-                        { // for all neighbor particles
+                        {
                             if (j == i)
                             {
                                 continue;
                             }
-                            glm::vec2 radiusIj = mPs.mParticleInfos[i].position - mPs.mParticleInfos[j].position;
-                            float diatanceIj = length(radiusIj);
+                            float diatanceIj = length(pi.position - mPs.mParticleInfos[j].position);
                             if (diatanceIj <= Lagrangian2dPara::supportRadius)
                             {
-                                mPs.mParticleInfos[i].density += mW.Value(diatanceIj);
+                                glm::vec2 kernel = mW.ValueAndGradFactor(diatanceIj);
+                                density += kernel.x;
+                                if (j > i)
+                                {
+                                    PairStream2d::Pair pair = {(uint32_t)j, diatanceIj, kernel.y};
+                                    stream.pairs.push_back(pair);
+                                }
                             }
                         }
                     }
-                }
+                    stream.offsets[i - stream.begin + 1] = stream.pairs.size();
 
-                mPs.mParticleInfos[i].density *= (mPs.mVolume * Lagrangian2dPara::density);
-                mPs.mParticleInfos[i].density = max(mPs.mParticleInfos[i].density, Lagrangian2dPara::density);
-                mPs.mParticleInfos[i].pressure = Lagrangian2dPara::stiffness * (std::powf(mPs.mParticleInfos[i].density / Lagrangian2dPara::density, Lagrangian2dPara::exponent) - 1.0);
-                mPs.mParticleInfos[i].pressDivDens2 = mPs.mParticleInfos[i].pressure / std::powf(mPs.mParticleInfos[i].density, 2);
+                    density *= (mPs.mVolume * Lagrangian2dPara::density);
+                    pi.density = max(density, Lagrangian2dPara::density);
+                    pi.pressure = Lagrangian2dPara::stiffness * (std::powf(pi.density / Lagrangian2dPara::density, Lagrangian2dPara::exponent) - 1.0);
+                    pi.pressDivDens2 = pi.pressure / std::powf(pi.density, 2);
+                }
             }
+            mPairStreamsRecorded = true;
         }
     }
 }
@@ -4,14 +4,12 @@
 
 #include <windows.h>
 #include <glm/glm.hpp>
-#include "GridData3d.h"
+#include "Grid3d.h"
 
 namespace FluidSimulation
 {
     namespace Eulerian3d
     {
-        using namespace boost::numeric;
-
         class MACGrid3d
         {
             friend MACGrid3d;
@@ -80,12 +78,12 @@ namespace FluidSimulation
             int dim[3];
 
         public:
-            Glb::GridData3dX mU;     // x
-            Glb::GridData3dY mV;     // y
-            Glb::GridData3dZ mW;     // z
-            Glb::CubicGridData3d mD; // density
-            Glb::CubicGridData3d mT; // temperature
-            Glb::GridData3d mSolid;  // solid
+            Glb::Grid3d<double, Glb::Stagger3d::FaceX> mU; // x
+            Glb::Grid3d<double, Glb::Stagger3d::FaceY> mV; // y
+            Glb::Grid3d<double, Glb::Stagger3d::FaceZ> mW; // z
+            Glb::Grid3d<double> mD;                        // density
+            Glb::Grid3d<double> mT;                        // temperature
+            Glb::Grid3d<unsigned char> mSolid;             // solid
         };
 
 #define FOR_EACH_CELL                                                    \
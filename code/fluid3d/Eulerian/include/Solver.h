@@ -5,15 +5,20 @@
 #pragma warning(disable : 4244 4267 4996)
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/io.hpp>
-#include <boost/numeric/ublas/matrix_sparse.hpp>
 
 #include "MACGrid3d.h"
+#include "PoissonStencil3d.h"
+#include "Multigrid3d.h"
+#include "Preconditioner3d.h"
+#include "FastPoisson3d.h"
 #include "Configure.h"
 
 namespace FluidSimulation
 {
 	namespace Eulerian3d
 	{
+		using namespace boost::numeric;
+
 		class Solver
 		{
 		public:
@@ -22,26 +27,30 @@ namespace FluidSimulation
 
 			virtual void solve();
 
-			void advectVelocity();
+			// semi-Lagrangian advection of the velocity and/or temperature and density
+			void advect(bool velocity, bool scalars);
 			void addExternalForces();
 			void project();
-			void advectTemperature();
-			void advectDensity();
 
 			void constructA();
 			void constructB(unsigned int numCells);
 			void constructPrecon();
+			void updateSolids();
 
 		protected:
 			MACGrid3d &mGrid;
 
-			MACGrid3d target; // ����advection�׶δ洢�µĳ�
+			MACGrid3d target; // back buffer: each stage writes its new fields here and swaps them into mGrid
 
 			unsigned int numCells = Eulerian3dPara::theDim3d[0] * Eulerian3dPara::theDim3d[1] * Eulerian3dPara::theDim3d[2];
 
-			ublas::compressed_matrix<double> A;
+			Glb::PoissonStencil3d A;
 			ublas::vector<double> b;
-			ublas::vector<double> precon;
+			ublas::vector<double> pressure; // last frame's pressure, the initial guess of the next solve
+			Glb::Multigrid3d multigrid;
+			Glb::Preconditioner3d preconditioner;
+			Glb::FastPoisson3d fastPoisson;
+			bool hasSolids;
 		};
 	}
 }
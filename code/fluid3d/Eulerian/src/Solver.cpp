@@ -3,10 +3,15 @@
 #include "Configure.h"
 #include "Global.h"
 
+#include <chrono>
+
 namespace FluidSimulation
 {
     namespace Eulerian3d
     {
+        // rows per side of the tiles the advection sweep hands out to the threads
+        static const int ADVECT_TILE = 8;
+
         Solver::Solver(MACGrid3d &grid) : mGrid(grid)
         {
             mGrid.reset();
@@ -28,10 +33,10 @@ namespace FluidSimulation
             // 3. projection
             // ...
 
-            target.reset();
+            updateSolids();
             Glb::Timer::getInstance().start();
 
-            advectVelocity();
+            advect(true, false);
 
             Glb::Timer::getInstance().recordTime("vel advection");
             addExternalForces();
@@ -42,43 +47,91 @@ namespace FluidSimulation
 
             Glb::Timer::getInstance().recordTime("projection");
 
-            advectTemperature();
-
-            advectDensity();
+            advect(false, true);
 
             Glb::Timer::getInstance().recordTime("temp & density advection");
         }
 
-        void Solver::advectVelocity()
+        void Solver::advect(bool velocity, bool scalars)
         {
-            FOR_EACH_FACE
+            // Every sample is traced back once through the current velocity field.
+            // Temperature and density live at the same cell centers, so they share
+            // the traced point and the interpolation lookup. The grid is swept in
+            // tiles of ADVECT_TILE x ADVECT_TILE rows along (j, k), each a run of
+            // contiguous i, and the tiles are spread over the threads.
+            int dimX = mGrid.dim[0], dimY = mGrid.dim[1], dimZ = mGrid.dim[2];
+            int tilesJ = (dimY + ADVECT_TILE) / ADVECT_TILE;
+            int tilesK = (dimZ + ADVECT_TILE) / ADVECT_TILE;
+            double dt = Eulerian3dPara::dt;
+
+#pragma omp parallel for schedule(dynamic)
+            for (int tile = 0; tile < tilesJ * tilesK; tile++)
             {
-                if (mGrid.isFace(i, j, k, mGrid.X))
-                {
-                    glm::vec3 pos = mGrid.getBackFace(i, j, k);
-                    glm::vec3 newpos = mGrid.traceBack(pos, Eulerian3dPara::dt);
-                    glm::vec3 newvel = mGrid.getVelocity(newpos);
-                    target.mU(i, j, k) = newvel[mGrid.X];
-                }
-                if (mGrid.isFace(i, j, k, mGrid.Y))
-                {
-                    glm::vec3 pos = mGrid.getLeftFace(i, j, k);
-                    glm::vec3 newpos = mGrid.traceBack(pos, Eulerian3dPara::dt);
-                    glm::vec3 newvel = mGrid.getVelocity(newpos);
-                    target.mV(i, j, k) = newvel[mGrid.Y];
-                }
-                if (mGrid.isFace(i, j, k, mGrid.Z))
+                int j0 = (tile / tilesK) * ADVECT_TILE;
+                int k0 = (tile % tilesK) * ADVECT_TILE;
+                int j1 = min(j0 + ADVECT_TILE, dimY + 1);
+                int k1 = min(k0 + ADVECT_TILE, dimZ + 1);
+
+                for (int j = j0; j < j1; j++)
                 {
-                    glm::vec3 pos = mGrid.getBottomFace(i, j, k);
-                    glm::vec3 newpos = mGrid.traceBack(pos, Eulerian3dPara::dt);
-                    glm::vec3 newvel = mGrid.getVelocity(newpos);
-                    target.mW(i, j, k) = newvel[mGrid.Z];
+                    for (int k = k0; k < k1; k++)
+                    {
+                        // which faces of the row exist, instead of isFace() per sample
+                        bool faceX = j < dimY && k < dimZ;
+                        bool faceY = k < dimZ;
+                        bool faceZ = j < dimY;
+
+                        if (velocity)
+                        {
+                            // a point inside a solid has zero velocity, as in getVelocity()
+                            for (int i = 0; i < dimX + 1; i++)
+                            {
+                                if (faceX)
+                                {
+                                    glm::vec3 newpos = mGrid.traceBack(mGrid.getBackFace(i, j, k), dt);
+                                    target.mU(i, j, k) = mGrid.inSolid(newpos) ? 0.0f : (float)mGrid.getVelocityX(newpos);
+                                }
+                                if (i == dimX)
+                                    break;
+                                if (faceY)
+                                {
+                                    glm::vec3 newpos = mGrid.traceBack(mGrid.getLeftFace(i, j, k), dt);
+                                    target.mV(i, j, k) = mGrid.inSolid(newpos) ? 0.0f : (float)mGrid.getVelocityY(newpos);
+                                }
+                                if (faceZ)
+                                {
+                                    glm::vec3 newpos = mGrid.traceBack(mGrid.getBottomFace(i, j, k), dt);
+                                    target.mW(i, j, k) = mGrid.inSolid(newpos) ? 0.0f : (float)mGrid.getVelocityZ(newpos);
+                                }
+                            }
+                        }
+
+                        if (scalars && j < dimY && k < dimZ)
+                        {
+                            for (int i = 0; i < dimX; i++)
+                            {
+                                glm::vec3 newpos = mGrid.traceBack(mGrid.getCenter(i, j, k), dt);
+                                Glb::Grid3d<double>::Location loc;
+                                mGrid.mT.locate(newpos, loc);
+                                target.mT(i, j, k) = mGrid.mT.interpolateCubic(loc);
+                                target.mD(i, j, k) = mGrid.mD.interpolateCubic(loc);
+                            }
+                        }
+                    }
                 }
             }
 
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
-            mGrid.mW = target.mW;
+            if (velocity)
+            {
+                mGrid.mU.swap(target.mU);
+                mGrid.mV.swap(target.mV);
+                mGrid.mW.swap(target.mW);
+            }
+            if (scalars)
+            {
+                mGrid.mT.swap(target.mT);
+                mGrid.mD.swap(target.mD);
+            }
         }
 
         void Solver::addExternalForces()
@@ -94,14 +147,14 @@ namespace FluidSimulation
                     target.mW(i, j, k) = vel;
                 }
             }
-            mGrid.mW = target.mW;
+            mGrid.mW.swap(target.mW);
 
             
             
-            Glb::GridData3d forcesX, forcesY, forcesZ;
-            forcesX.initialize();
-            forcesY.initialize();
-            forcesZ.initialize();
+            Glb::Grid3d<double> forcesX, forcesY, forcesZ;
+            forcesX.initialize(mGrid.dim, mGrid.cellSize);
+            forcesY.initialize(mGrid.dim, mGrid.cellSize);
+            forcesZ.initialize(mGrid.dim, mGrid.cellSize);
 
             FOR_EACH_CELL
             {
@@ -141,9 +194,9 @@ namespace FluidSimulation
                 }
             }
 
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
-            mGrid.mW = target.mW;
+            mGrid.mU.swap(target.mU);
+            mGrid.mV.swap(target.mV);
+            mGrid.mW.swap(target.mW);
 
         }
 
@@ -154,10 +207,50 @@ namespace FluidSimulation
             // https://yangwc.com/2019/08/03/MakingFluidImcompressible/
 
             constructB(numCells);
-            ublas::vector<double> p(numCells); // = conjugateGradient(A, b, precon);
-
-            Glb::cg_psolve3d(A, precon, b, p, 500, 0.005);
-            //
+            // warm start from the previous frame's pressure
+            ublas::vector<double> &p = pressure;
+            double tol = Eulerian3dPara::pressureTolerance;
+            if (Eulerian3dPara::relativeTolerance)
+                tol *= norm_2(b);
+
+            int iterations = 0;
+            double residual = 0.0;
+            auto solveStart = std::chrono::steady_clock::now();
+            switch (Eulerian3dPara::pressureSolver)
+            {
+            case 1:
+                // plain V-cycles can stall next to thin solids (see Multigrid3d), MG-PCG then
+                // continues from the current pressure and the V-cycles count as iterations
+                if (!multigrid.solve(b, p, 100, tol, iterations, residual))
+                {
+                    int cgIterations = 0;
+                    Glb::cg_mgsolve3d(A, multigrid, b, p, 500, tol, cgIterations, residual);
+                    iterations += cgIterations;
+                }
+                break;
+            case 3:
+                if (!hasSolids)
+                {
+                    // direct solve, the residual is only measured for the Inspector
+                    fastPoisson.solve(b, p);
+                    ublas::vector<double> r(b.size());
+                    A.residual(b, p, r, 1.0);
+                    residual = norm_2(r);
+                    break;
+                }
+                // interior solids: fall back to MG-PCG
+            case 2:
+                Glb::cg_mgsolve3d(A, multigrid, b, p, 500, tol, iterations, residual);
+                break;
+            default:
+                if (preconditioner.type != Eulerian3dPara::preconditioner)
+                    preconditioner.build(A, Eulerian3dPara::preconditioner);
+                Glb::cg_psolve3d(A, preconditioner, b, p, 500, tol, iterations, residual);
+                break;
+            }
+            Eulerian3dPara::pressureTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+            Eulerian3dPara::pressureIterations = iterations;
+            Eulerian3dPara::pressureResidual = residual;
             // Glb::cg_solve3d(A, b, p, 500, 0.005);
 
             // Subtract pressure from our velocity and save in target
@@ -220,59 +313,43 @@ namespace FluidSimulation
                 }
             }
 
-            mGrid.mU = target.mU;
-            mGrid.mV = target.mV;
-            mGrid.mW = target.mW;
+            mGrid.mU.swap(target.mU);
+            mGrid.mV.swap(target.mV);
+            mGrid.mW.swap(target.mW);
             assert(mGrid.checkDivergence());
         }
 
-        void Solver::advectTemperature()
+        void Solver::constructA()
         {
+            // A is never assembled: the stencil only needs to know which cells are fluid
+            A.resize(mGrid.dim[0], mGrid.dim[1], mGrid.dim[2]);
+            fastPoisson.build(mGrid.dim[0], mGrid.dim[1], mGrid.dim[2]);
+            pressure.resize(A.size1());
+            std::fill(pressure.begin(), pressure.end(), 0.0);
             FOR_EACH_CELL
             {
-                glm::vec3 pos = mGrid.getCenter(i, j, k);
-                glm::vec3 newpos = mGrid.traceBack(pos, Eulerian3dPara::dt);
-                double newt = mGrid.getTemperature(newpos);
-                target.mT(i, j, k) = newt;
+                A.setFluid(i, j, k, !mGrid.isSolidCell(i, j, k));
             }
-            mGrid.mT = target.mT;
         }
 
-        void Solver::advectDensity()
+        void Solver::updateSolids()
         {
+            // Only cells whose solid flag changed are touched. The preconditioner
+            // depends on the flags too, so it is rebuilt if any of them did.
+            bool changed = false;
             FOR_EACH_CELL
             {
-                glm::vec3 pos = mGrid.getCenter(i, j, k);
-                glm::vec3 newpos = mGrid.traceBack(pos, Eulerian3dPara::dt);
-                double newd = mGrid.getDensity(newpos);
-                target.mD(i, j, k) = newd;
+                if (A.setFluid(i, j, k, !mGrid.isSolidCell(i, j, k)))
+                {
+                    // a cell that changed type restarts from zero pressure
+                    pressure(mGrid.getIndex(i, j, k)) = 0.0;
+                    changed = true;
+                }
             }
-            mGrid.mD = target.mD;
-        }
 
-        void Solver::constructA()
-        {
-            unsigned int numCells = mGrid.mSolid.data().size();
-            A.resize(numCells, numCells, false);
-
-            for (unsigned int row = 0; row < numCells; row++)
+            if (changed)
             {
-                int ri, rj, rk;
-                mGrid.getCell(row, ri, rj, rk); // Each row corresponds to a cell
-                if (mGrid.isSolidCell(ri, rj, rk))
-                    continue;
-                for (unsigned int col = 0; col < numCells; col++)
-                {
-                    int ci, cj, ck;
-                    mGrid.getCell(col, ci, cj, ck); // Each col corresponds to a possible neighbor
-                    if (mGrid.isSolidCell(ci, cj, ck))
-                        continue;
-                    double coeff = mGrid.getPressureCoeffBetweenCells(ri, rj, rk, ci, cj, ck);
-                    if (fabs(coeff) > 0.0001)
-                    {
-                        A(row, col) = coeff;
-                    }
-                }
+                constructPrecon();
             }
         }
 
@@ -295,61 +372,14 @@ namespace FluidSimulation
             }
         }
 
-#define VALA(r, c) (r != -1 && c != -1) ? A(r, c) : 0
         void Solver::constructPrecon()
         {
-            precon.resize(A.size1());
-            std::fill(precon.begin(), precon.end(), 0);
-
-            double tau = 0.0; // Disable MIC(0) 0.97;
-            for (unsigned int index = 0; index < A.size1(); index++)
-            {
-                int i, j, k;
-                mGrid.getCell(index, i, j, k);
-                if (mGrid.isSolidCell(i, j, k))
-                    continue;
-
-                int neighbori = mGrid.getIndex(i - 1, j, k);
-                int neighborj = mGrid.getIndex(i, j - 1, k);
-                int neighbork = mGrid.getIndex(i, j, k - 1);
-                double termi = neighbori != -1 ? A(index, neighbori) * precon(neighbori) : 0;
-                double termj = neighborj != -1 ? A(index, neighborj) * precon(neighborj) : 0;
-                double termk = neighbork != -1 ? A(index, neighbork) * precon(neighbork) : 0;
-
-                double termii = 0;
-                if (neighbori != -1)
-                {
-                    int neighborij = mGrid.getIndex(i - 1, j + 1, k);
-                    int neighborik = mGrid.getIndex(i - 1, j, k + 1);
-                    double termii0 = (VALA(neighbori, neighborij) + VALA(neighbori, neighborik));
-                    double termii1 = precon(neighbori) * precon(neighbori);
-                    termii = VALA(index, neighbori) * termii0 / termii1;
-                }
+            // the multigrid levels are coarsened from the same solid flags
+            multigrid.build(A);
+            preconditioner.build(A, Eulerian3dPara::preconditioner);
 
-                double termjj = 0;
-                if (neighborj != -1)
-                {
-                    int neighborji = mGrid.getIndex(i + 1, j - 1, k);
-                    int neighborjk = mGrid.getIndex(i, j - 1, k + 1);
-                    double termjj0 = (VALA(neighborj, neighborji) + VALA(neighborj, neighborjk));
-                    double termjj1 = precon(neighborj) * precon(neighborj);
-                    termjj = VALA(index, neighborj) * termjj0 / termjj1;
-                }
-
-                double termkk = 0;
-                if (neighbork != -1)
-                {
-                    int neighborki = mGrid.getIndex(i + 1, j, k - 1);
-                    int neighborkj = mGrid.getIndex(i, j + 1, k - 1);
-                    double termkk0 = (VALA(neighbork, neighborki) + VALA(neighbork, neighborkj));
-                    double termkk1 = precon(neighbork) * precon(neighbork);
-                    termkk = VALA(index, neighbork) * termkk0 / termkk1;
-                }
-
-                double e = A(index, index) - termi * termi - termj * termj - termk * termk - tau * (termii + termjj + termkk);
-
-                precon(index) = 1 / sqrt(e);
-            }
+            // the spectral solver only applies to an empty box
+            hasSolids = mGrid.numSolidCells() > 0;
         }
     }
 }
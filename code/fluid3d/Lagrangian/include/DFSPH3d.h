@@ -0,0 +1,65 @@
+#pragma once
+#ifndef __DFSPH_3D_H__
+#define __DFSPH_3D_H__
+
+#include "ParticleSystem3d.h"
+#include "WCubicSpline.h"
+#include "Configure.h"
+
+namespace FluidSimulation
+{
+
+    namespace Lagrangian3d
+    {
+        // Divergence-free SPH (Bender and Koschier): the pressure is not taken from an
+        // equation of state but solved for, by two Jacobi-style iterations on the velocities.
+        //   density solve:    makes the density predicted at the end of the step match
+        //                     the rest density wherever the fluid would be compressed
+        //   divergence solve: makes the rate of change of the density zero
+        // Both use the per-particle factor alpha of the current neighbourhood, so the
+        // neighbours found by computeDensityAndFactor are kept as a pair list with the
+        // mass-weighted kernel gradients and reused by every iteration of the step.
+        class DFSPH3d
+        {
+        public:
+            DFSPH3d(ParticleSystem3d &ps, Glb::WCubicSpline3d &w);
+            ~DFSPH3d();
+
+            // densities, the factors alpha and the pair list of the current positions;
+            // pressure and pressDivDens2 are set to zero, so the acceleration pass only
+            // adds viscosity and gravity
+            void computeDensityAndFactor();
+
+            // corrects the velocities so that the density does not change, dt is the last step
+            void correctDivergenceError(float dt);
+
+            // corrects the predicted velocities of a step of dt so that the density at its
+            // end does not exceed the rest density
+            void correctDensityError(float dt);
+
+            int divergenceIterations;
+            float divergenceError; // mean relative density change per step
+            int densityIterations;
+            float densityError;    // mean relative compression
+
+        private:
+            // one solver iteration: the source term of every particle from the current
+            // velocities (density change over dt, or its rate when dt == 0), then the
+            // velocity correction. Returns the mean relative error before the correction
+            float densitySourceTerm(float dt, bool divergence);
+            void correctVelocities();
+
+            ParticleSystem3d &mPs;
+            Glb::WCubicSpline3d &mW;
+            std::vector<float> mFactor;            // alpha of every particle
+            std::vector<float> mStiffness;         // kappa / rho of the current iteration
+            std::vector<uint32_t> mPairOffsets;    // pairs of i are [mPairOffsets[i], mPairOffsets[i + 1])
+            std::vector<uint32_t> mPairIndices;    // j of every pair, i itself excluded
+            std::vector<glm::vec3> mPairGradients; // m * grad W(xi - xj)
+            std::vector<std::vector<uint32_t>> mThreadIndices;    // pairs gathered by every thread, kept between steps
+            std::vector<std::vector<glm::vec3>> mThreadGradients;
+        };
+    }
+}
+
+#endif
@@ -33,6 +33,11 @@ namespace FluidSimulation
             virtual void init();
             virtual void simulate();
             virtual GLuint getRenderedTexture();
+
+        private:
+            static void createScene(ParticleSystem3d &ps);
+            void benchmarkPressureSolvers();
+            double updateEmitters(float dt); // milliseconds the emitters and sinks took
         };
     }
 }
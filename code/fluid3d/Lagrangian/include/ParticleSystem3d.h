@@ -6,6 +6,7 @@
 #include <vector>
 #include "Configure.h"
 #include "WCubicSpline.h"
+#include "CountingSort.h"
 
 namespace FluidSimulation
 {
@@ -24,6 +25,74 @@ namespace FluidSimulation
             alignas(4) uint32_t blockId;
         };
 
+        // 粒子数据的 SoA 存储：每个分量一个连续数组，邻域循环只读取用到的分量，也便于向量化
+        // 模拟只读写这里的数据，particle3d 数组只作为渲染器上传用的视图
+        struct ParticleArrays3d
+        {
+            std::vector<float> posX, posY, posZ;
+            std::vector<float> velX, velY, velZ;
+            std::vector<float> accX, accY, accZ;
+            std::vector<float> density;
+            std::vector<float> pressure;
+            std::vector<float> pressDivDens2;
+            std::vector<uint32_t> blockId;
+
+            int size() const { return (int)blockId.size(); }
+            void clear();
+            void resize(int n);
+            void reserve(int n); // 连同重排缓冲一起预留容量，之后粒子数不超过 n 时不会重新分配内存
+
+            glm::vec3 position(int i) const { return glm::vec3(posX[i], posY[i], posZ[i]); }
+            glm::vec3 velocity(int i) const { return glm::vec3(velX[i], velY[i], velZ[i]); }
+            void setPosition(int i, const glm::vec3 &p) { posX[i] = p.x; posY[i] = p.y; posZ[i] = p.z; }
+            void setVelocity(int i, const glm::vec3 &v) { velX[i] = v.x; velY[i] = v.y; velZ[i] = v.z; }
+
+            // 按排列重排所有数组：重排后的第 i 个粒子是原来的第 order[i] 个
+            // fields 为 true 时密度和压力也跟着粒子重排，供不再重新计算它们的休眠粒子使用
+            void reorder(const std::vector<uint32_t> &order, bool fields);
+
+        private:
+            std::vector<float> mScratch; // 重排用的缓冲，与被重排的数组交换，下次继续复用
+            std::vector<uint32_t> mScratchId;
+        };
+
+        // Verlet 邻居表：以支撑半径加 skin 为半径的候选邻居，CSR 格式
+        // 所有粒子自建表以来的位移都不超过 skin 的一半时，候选邻居一定包含支撑半径内的全部邻居，表可以跨子步复用
+        struct NeighborList3d
+        {
+            std::vector<uint32_t> offsets; // 粒子 i 的候选邻居为 indices[offsets[i], offsets[i + 1])
+            std::vector<uint32_t> indices;
+            std::vector<glm::vec3> refPosition; // 建表时的粒子位置
+            float skin = 0.0f;
+            std::vector<std::vector<uint32_t>> threadIndices; // 建表时每个线程的缓冲
+            std::vector<std::vector<int32_t>> threadBlocks;   // 建表时每个线程当前粒子要遍历的block
+
+            // 每一步由密度计算填写，加速度计算直接复用
+            std::vector<float> distance;
+            std::vector<glm::vec2> kernel; // WCubicSpline3d::GetGrad 的结果，超出支撑半径的为 0
+
+            void clear();
+        };
+
+        // 粒子源：以 center 为中心、边长为 size 的正方形喷口，与 velocity 垂直
+        // 流体每前进一个粒子间距，喷口就沿 velocity 射出一层粒子
+        struct Emitter3d
+        {
+            glm::vec3 center;
+            glm::vec3 velocity;
+            float size;
+            float particleSpace;
+            float travel = 0.0f;  // 上一层粒子射出后流体前进的距离
+            uint64_t emitted = 0; // 已射出的粒子数，用作随机偏移的计数器
+        };
+
+        // 粒子汇：进入这个轴对齐盒子的粒子被删除
+        struct Sink3d
+        {
+            glm::vec3 lower;
+            glm::vec3 upper;
+        };
+
         class ParticleSystem3d
         {
         public:
@@ -32,8 +101,94 @@ namespace FluidSimulation
 
             void setContainerSize(glm::vec3 corner, glm::vec3 size);
             int32_t addFluidBlock(glm::vec3 corner, glm::vec3 size, glm::vec3 v0, float particleSpace);
+            void addEmitter(glm::vec3 center, glm::vec3 velocity, float size, float particleSpace);
+            void addSink(glm::vec3 corner, glm::vec3 size);
+            // 粒子池：为 capacity 个粒子预留所有数组，粒子源只在容量之内追加粒子，池满时暂停射出
+            void reserve(int capacity);
+            // 删除进入粒子汇的粒子，再由粒子源射出 dt 内的粒子，返回射出的粒子数
+            // 删除只是标记，粒子在下一次 updateBlockInfo() 的排序中被移到数组末尾截掉
+            int updateEmitters(float dt);
             uint32_t getBlockIdByPosition(glm::vec3 position);
+            uint32_t getBlockId(glm::uvec3 cell) const
+            {
+                if (mMortonOrder)
+                {
+                    return expandBits(cell.x) | (expandBits(cell.y) << 1) | (expandBits(cell.z) << 2);
+                }
+                return cell.z * mBlockNum.x * mBlockNum.y + cell.y * mBlockNum.x + cell.x;
+            }
+            glm::uvec3 getBlockCell(uint32_t blockId) const
+            {
+                if (mMortonOrder)
+                {
+                    return glm::uvec3(compactBits(blockId), compactBits(blockId >> 1), compactBits(blockId >> 2));
+                }
+                return glm::uvec3(blockId % mBlockNum.x, blockId / mBlockNum.x % mBlockNum.y, blockId / (mBlockNum.x * mBlockNum.y));
+            }
+
+            // 位置所在的单元格，容器下界所在的单元格为 (0, 0, 0)，容器外的坐标可以为负
+            glm::ivec3 getCell(glm::vec3 position) const
+            {
+                return glm::ivec3(glm::floor((position - mLowerBound) / mBlockSize));
+            }
+
+            // 单元格对应的block。稠密网格下即 getBlockId，超出容器的为 -1
+            // 稀疏网格下为单元格在哈希表中的槽位：8x8x8 个单元格为一块，块内按 Morton 序占据连续的 512 个槽位，
+            // 块的起始槽位由块坐标的哈希决定。不同的单元格可能落在同一个槽位，遍历时按距离筛选
+            int32_t getCellBlock(glm::ivec3 cell) const
+            {
+                if (mSparseGrid)
+                {
+                    glm::uvec3 c = glm::uvec3(cell);
+                    uint32_t local = expandBits(c.x & 7) | (expandBits(c.y & 7) << 1) | (expandBits(c.z & 7) << 2);
+                    uint32_t hash = ((c.x >> 3) * 73856093u) ^ ((c.y >> 3) * 19349663u) ^ ((c.z >> 3) * 83492791u);
+                    hash ^= hash >> 16;
+                    hash *= 0x85ebca6bu;
+                    hash ^= hash >> 13;
+                    return ((hash << 9) | local) & (mBlockIdNum - 1);
+                }
+                if (cell.x < 0 || cell.y < 0 || cell.z < 0 ||
+                    cell.x >= (int)mBlockNum.x || cell.y >= (int)mBlockNum.y || cell.z >= (int)mBlockNum.z)
+                {
+                    return -1;
+                }
+                return getBlockId(glm::uvec3(cell));
+            }
+
+            // 求出单元格周围 3x3x3 个单元格的block，按 k、j、i 的顺序
+            // 超出容器的为 -1；稀疏网格下已经出现过的槽位也为 -1，每个粒子只被遍历一次
+            static const int NEIGHBOR_BLOCK_NUM = 27;
+            void getNeighborBlocks(glm::ivec3 cell, int32_t neighbors[NEIGHBOR_BLOCK_NUM]) const
+            {
+                int p = 0;
+                for (int k = -1; k <= 1; k++)
+                {
+                    for (int j = -1; j <= 1; j++)
+                    {
+                        for (int i = -1; i <= 1; i++)
+                        {
+                            int32_t block = getCellBlock(cell + glm::ivec3(i, j, k));
+                            for (int q = 0; mSparseGrid && q < p; q++)
+                            {
+                                if (neighbors[q] == block)
+                                {
+                                    block = -1;
+                                    break;
+                                }
+                            }
+                            neighbors[p++] = block;
+                        }
+                    }
+                }
+            }
             void updateBlockInfo();
+            // 休眠：自身和相邻 block 中所有粒子的速度和加速度连续 Lagrangian3dPara::sleepSteps 步低于阈值的 block 进入休眠，
+            // 直到自身或相邻 block 中有粒子重新超过阈值。休眠的粒子被冻结：速度和加速度保持为 0，不会移动，
+            // 密度和压力保持入睡时的值，只计算它们对醒着的邻居的贡献，醒着的邻居对它们的作用力被丢弃
+            // 由 Solver 在每一步开始时调用，enabled 为 false 时唤醒所有 block
+            void updateSleepingBlocks(bool enabled);
+            void updateRenderView(); // 把 mParticles 写入 particles，供渲染器上传
+            bool useNeighborList() const; // 本步的邻域遍历是否使用 mNeighborList
 
         public:
             // 粒子参数
@@ -43,8 +198,9 @@ namespace FluidSimulation
             float mParticleDiameter = Lagrangian3dPara::particleDiameter;
             float mVolume = std::pow(mParticleDiameter, 3); // 体积
 
-            std::vector<particle3d> particles;
-            int maxNeighborNum = 512;
+            ParticleArrays3d mParticles;
+            std::vector<particle3d> particles; // 渲染用的 AoS 视图，由 updateRenderView() 更新
+            NeighborList3d mNeighborList;       // Lagrangian3dPara::neighborList 打开时由 updateBlockInfo() 维护
 
             // 容器参数
             glm::vec3 mLowerBound = glm::vec3(FLT_MAX);
@@ -52,8 +208,56 @@ namespace FluidSimulation
             glm::vec3 mContainerCenter = glm::vec3(0.0f);
             glm::uvec3 mBlockNum = glm::uvec3(0); // XYZ轴有几个block
             glm::vec3 mBlockSize = glm::vec3(0.0f);
+            uint32_t mBlockIdNum = 0; // blockId 的取值范围，Morton 序下包含不对应任何block的空号，稀疏网格下为哈希表大小
             std::vector<glm::uvec2> mBlockExtens; // 记载着每个block含有那个索引区间的粒子（索引为mParticleInfos的索引）
-            std::vector<int32_t> mBlockIdOffs;
+
+            // 被删除粒子的 blockId，超出任何网格的范围，计数排序把它们排在所有粒子之后
+            static const uint32_t REMOVED_BLOCK_ID = 0xffffffff;
+            std::vector<Emitter3d> mEmitters;
+            std::vector<Sink3d> mSinks;
+
+            // 由 updateSleepingBlocks() 维护，休眠未打开时为空
+            std::vector<uint8_t> mBlockSleeping; // 每个 blockId 是否休眠
+            std::vector<uint8_t> mSleeping;      // 与 mParticles 同序，0 醒着，1 休眠但附近有醒着的粒子，2 休眠且相邻的 block 也都在休眠
+            int mActiveNum = 0;                  // 未休眠的粒子数
+
+        private:
+            // Morton 码：把 10 位整数的各位之间插入两个 0
+            static uint32_t expandBits(uint32_t v)
+            {
+                v &= 0x3ff;
+                v = (v | (v << 16)) & 0x030000ff;
+                v = (v | (v << 8)) & 0x0300f00f;
+                v = (v | (v << 4)) & 0x030c30c3;
+                v = (v | (v << 2)) & 0x09249249;
+                return v;
+            }
+            static uint32_t compactBits(uint32_t v)
+            {
+                v &= 0x09249249;
+                v = (v | (v >> 2)) & 0x030c30c3;
+                v = (v | (v >> 4)) & 0x0300f00f;
+                v = (v | (v >> 8)) & 0x030000ff;
+                v = (v | (v >> 16)) & 0x000003ff;
+                return v;
+            }
+
+            void setBlockOrder(); // 按 Lagrangian3dPara::blockOrder 和 sparseGrid 选择 blockId 的编号方式
+            uint32_t sparseTableSize() const;
+            bool neighborListValid() const;
+            void buildNeighborList();
+            void benchmarkBlockSort(); // 计时比较排序与计数排序，结果写入日志
+
+            Glb::CountingSort mBlockSort;
+            std::vector<uint32_t> mSortOrder; // 按 blockId 排序后的粒子排列
+            int mBlockOrder = -1;      // 建表时的 Lagrangian3dPara::blockOrder
+            bool mMortonOrder = false; // 实际使用的编号方式，block 数超出 Morton 码范围时退回行优先
+            bool mSparseGrid = false;  // 建表时的 Lagrangian3dPara::sparseGrid
+            int mCapacity = 0;         // 粒子池的容量
+            bool mRemoved = false;     // 有粒子被标记删除，下一次 updateBlockInfo() 必须排序
+            bool mPoolFull = false;    // 池满的消息已经写入日志
+            std::vector<uint8_t> mBlockActive; // 本步 block 中是否有速度或加速度超过阈值的粒子
+            std::vector<int> mBlockCalmSteps;  // block 和相邻 block 连续不活跃的步数
         };
 
     }
@@ -3,6 +3,8 @@
 #define __LAGRANGIAN_3D_SOLVER_H__
 
 #include "ParticleSystem3d.h"
+#include "SphKernels3d.h"
+#include "DFSPH3d.h"
 #include "WCubicSpline.h"
 #include "Global.h"
 #include "Configure.h"
@@ -13,24 +15,52 @@ namespace FluidSimulation
 
     namespace Lagrangian3d
     {
+        // the pairs j > i inside the support radius that computeDensityAndPress met on
+        // its walk over the grid, replayed by computeAccleration when
+        // Lagrangian3dPara::pairStream is set. Every thread records one stream over a
+        // contiguous range of particles
+        struct PairStream3d
+        {
+            int begin;
+            int end;
+            std::vector<uint32_t> offsets; // pairs of particle begin + k are [offsets[k], offsets[k + 1])
+            std::vector<SphPair3d> pairs;  // grows by whole blocks of candidates, only offsets.back() are used
+        };
+
         class Solver
         {
         public:
             Solver(ParticleSystem3d &ps);
             ~Solver();
 
-            void solve();
+            // one step of Lagrangian3dPara::dt, or with adaptiveTimeStep of the dt the
+            // stability criteria allow, cut so that it does not pass timeLeft. Returns the step taken
+            float solve(float timeLeft = FLT_MAX);
 
         private:
+            float solveDivergenceFree(float timeLeft);
+            float adaptiveTimeStep(float timeLeft);
             void eulerIntegration();
+            void integrateVelocity();
+            void integratePosition();
             void computeDensityAndPress();
+            void recordPairStreams();
             void computeAccleration();
             void boundaryCondition();
             void calculateBlockId();
+            void selectKernels();
+            SphPairParams pairParams();
 
         private:
             ParticleSystem3d &mPs;
             Glb::WCubicSpline3d mW;
+            DFSPH3d mDfsph;
+            float mDt; // step of the current solve
+            SphKernels3d mKernels;
+            int mKernelsRequested; // Lagrangian3dPara::simd the kernels were selected for
+            std::vector<std::vector<float>> mThreadAcc; // per thread accelerations scattered to the j side of the pairs, all x, then y, then z
+            std::vector<PairStream3d> mPairStreams;
+            bool mPairStreamsRecorded; // set by recordPairStreams, cleared once computeAccleration used them
         };
     }
 }
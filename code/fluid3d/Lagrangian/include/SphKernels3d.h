@@ -0,0 +1,68 @@
+#pragma once
+#ifndef __SPH_KERNELS_3D_H__
+#define __SPH_KERNELS_3D_H__
+
+#include "ParticleSystem3d.h"
+
+namespace FluidSimulation
+{
+
+    namespace Lagrangian3d
+    {
+        // Constants of the pair sums, taken once per pass
+        struct SphPairParams
+        {
+            float supportRadius;
+            const float *kernelTable; // WCubicSpline3d value and gradient factor pairs
+            int kernelTableSize;      // pairs in the table
+            float viscosityFactor;
+            float pressureFactor;
+            float denomEps;
+        };
+
+        // A pair (i, j) recorded by the density pass for the force pass: the neighbour, the
+        // distance and the kernel gradient factor, grad W = gradFactor * (xi - xj)
+        struct SphPair3d
+        {
+            uint32_t j;
+            float distance;
+            float gradFactor;
+        };
+
+        // The pair loops of the 3D solver over one block of the neighbour grid, i.e. a
+        // contiguous range [begin, end) of the sorted particles. The AVX2 and AVX-512
+        // versions load 8 or 16 candidates at a time from the particle arrays, look the
+        // kernel up with a gather and mask out the candidates beyond the support radius.
+        // They sum in a different order than the scalar version, so results agree to
+        // float rounding
+        struct SphKernels3d
+        {
+            enum Isa
+            {
+                Scalar,
+                AVX2,
+                AVX512
+            };
+
+            // sum of W(|xi - xj|) over j in [begin, end)
+            float (*density)(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end);
+
+            // density, and appends the pairs inside the support radius with j > i to
+            // pairs[count], which has room for end - begin more
+            float (*densityAndPairs)(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+                                     SphPair3d *pairs, int &count);
+
+            // viscosity and pressure accelerations of the pairs (i, j) for j in [begin, end),
+            // all j > i. Returns the share of i and subtracts the share of j from accX/Y/Z[j]
+            glm::vec3 (*acceleration)(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+                                      float *accX, float *accY, float *accZ);
+
+            int isa;
+
+            // the widest version up to maxIsa this CPU runs
+            static SphKernels3d select(int maxIsa);
+        };
+    }
+}
+
+#endif
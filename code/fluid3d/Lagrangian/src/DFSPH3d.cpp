@@ -0,0 +1,228 @@
+#include "fluid3d/Lagrangian/include/DFSPH3d.h"
+#include <omp.h>
+
+namespace FluidSimulation
+{
+
+	namespace Lagrangian3d
+	{
+		// fewest iterations of each solve, one correction alone tends to overshoot
+		static const int MIN_DENSITY_ITERATIONS = 2;
+		static const int MIN_DIVERGENCE_ITERATIONS = 1;
+
+		static int numThreads()
+		{
+			return Lagrangian3dPara::threads > 0 ? Lagrangian3dPara::threads : omp_get_max_threads();
+		}
+
+		DFSPH3d::DFSPH3d(ParticleSystem3d &ps, Glb::WCubicSpline3d &w)
+			: divergenceIterations(0), divergenceError(0.0f), densityIterations(0), densityError(0.0f), mPs(ps), mW(w)
+		{
+
+		}
+
+		DFSPH3d::~DFSPH3d()
+		{
+
+		}
+
+		void DFSPH3d::computeDensityAndFactor()
+		{
+			// alpha_i = rho_i / (|sum_j m grad W_ij|^2 + sum_j |m grad W_ij|^2), the inverse of the
+			// diagonal of the system relating kappa to the density change. The pairs are gathered
+			// per thread over contiguous particle ranges, then placed after a prefix sum
+			ParticleArrays3d &p = mPs.mParticles;
+			NeighborList3d &list = mPs.mNeighborList;
+			bool useList = mPs.useNeighborList();
+			int particleNum = p.size();
+			float h = Lagrangian3dPara::supportRadius;
+			float mass = mPs.mVolume * Lagrangian3dPara::density;
+			mFactor.resize(particleNum);
+			mStiffness.resize(particleNum);
+			mPairOffsets.resize(particleNum + 1);
+			mPairOffsets[0] = 0;
+
+			int threadNum = numThreads();
+			mThreadIndices.resize(threadNum);
+			mThreadGradients.resize(threadNum);
+#pragma omp parallel num_threads(threadNum)
+			{
+				int thread = omp_get_thread_num();
+				int usedThreads = omp_get_num_threads();
+				int begin = (long long)particleNum * thread / usedThreads;
+				int end = (long long)particleNum * (thread + 1) / usedThreads;
+				std::vector<uint32_t> &indices = mThreadIndices[thread];
+				std::vector<glm::vec3> &gradients = mThreadGradients[thread];
+				indices.clear();
+				gradients.clear();
+				for (int i = begin; i < end; i++)
+				{
+					glm::vec3 positionI = p.position(i);
+					uint32_t count = indices.size();
+					float density = 0.0f;
+					int32_t neighborBlocks[ParticleSystem3d::NEIGHBOR_BLOCK_NUM];
+					int candidateLists = 1;
+					if (!useList)
+					{
+						mPs.getNeighborBlocks(mPs.getCell(positionI), neighborBlocks);
+						candidateLists = ParticleSystem3d::NEIGHBOR_BLOCK_NUM;
+					}
+					for (int k = 0; k < candidateLists; k++)
+					{
+						int first, last;
+						if (useList)
+						{
+							first = list.offsets[i];
+							last = list.offsets[i + 1];
+						}
+						else if (neighborBlocks[k] >= 0)
+						{
+							first = mPs.mBlockExtens[neighborBlocks[k]].x;
+							last = mPs.mBlockExtens[neighborBlocks[k]].y;
+						}
+						else
+						{
+							continue;
+						}
+						for (int e = first; e < last; e++)
+						{
+							int j = useList ? list.indices[e] : e;
+							glm::vec3 radiusIj = positionI - p.position(j);
+							float diatanceIj = glm::length(radiusIj);
+							glm::vec2 kernel = glm::vec2(0.0f);
+							if (diatanceIj <= h)
+							{
+								kernel = mW.GetGrad(min(diatanceIj / h, 0.999f));
+								density += kernel.r;
+								if (j != i)
+								{
+									indices.push_back(j);
+									gradients.push_back(mass * kernel.g * radiusIj);
+								}
+							}
+							if (useList)
+							{
+								// the viscosity of Solver::computeAccleration reads them back
+								list.distance[e] = diatanceIj;
+								list.kernel[e] = kernel;
+							}
+						}
+					}
+
+					glm::vec3 gradientSum = glm::vec3(0.0f);
+					float gradient2Sum = 0.0f;
+					for (int e = count; e < indices.size(); e++)
+					{
+						gradientSum += gradients[e];
+						gradient2Sum += glm::dot(gradients[e], gradients[e]);
+					}
+					float denom = glm::dot(gradientSum, gradientSum) + gradient2Sum;
+					p.density[i] = density * mass;
+					p.pressure[i] = 0.0f;
+					p.pressDivDens2[i] = 0.0f;
+					mFactor[i] = denom > 1e-6f ? p.density[i] / denom : 0.0f;
+					mPairOffsets[i + 1] = indices.size() - count;
+				}
+
+#pragma omp barrier
+#pragma omp single
+				{
+					for (int i = 0; i < particleNum; i++)
+					{
+						mPairOffsets[i + 1] += mPairOffsets[i];
+					}
+					mPairIndices.resize(mPairOffsets[particleNum]);
+					mPairGradients.resize(mPairOffsets[particleNum]);
+				}
+
+				std::copy(indices.begin(), indices.end(), mPairIndices.begin() + mPairOffsets[begin]);
+				std::copy(gradients.begin(), gradients.end(), mPairGradients.begin() + mPairOffsets[begin]);
+			}
+		}
+
+		float DFSPH3d::densitySourceTerm(float dt, bool divergence)
+		{
+			// density:    rho*_i = rho_i + dt * sum_j (v_i - v_j) . m grad W_ij, kappa_i dt = (rho*_i - rho0) / dt * alpha_i
+			// divergence: D rho_i / Dt = sum_j (v_i - v_j) . m grad W_ij,     kappa_i dt = D rho_i / Dt * alpha_i
+			// only compression is corrected, the fluid may still separate at the surface
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+			float density0 = Lagrangian3dPara::density;
+			double errorSum = 0.0;
+#pragma omp parallel for schedule(static, 256) reduction(+ : errorSum) num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
+			{
+				glm::vec3 velocityI = p.velocity(i);
+				float change = 0.0f;
+				for (int e = mPairOffsets[i]; e < mPairOffsets[i + 1]; e++)
+				{
+					change += glm::dot(velocityI - p.velocity(mPairIndices[e]), mPairGradients[e]);
+				}
+
+				float kappa;
+				if (divergence)
+				{
+					change = max(change, 0.0f);
+					kappa = change * mFactor[i];
+					errorSum += change * dt / density0;
+				}
+				else
+				{
+					float compression = max(p.density[i] + dt * change - density0, 0.0f);
+					kappa = compression / dt * mFactor[i];
+					errorSum += compression / density0;
+				}
+				mStiffness[i] = kappa / p.density[i];
+			}
+			return particleNum > 0 ? errorSum / particleNum : 0.0f;
+		}
+
+		void DFSPH3d::correctVelocities()
+		{
+			// v_i -= sum_j (kappa_i / rho_i + kappa_j / rho_j) m grad W_ij, kappa already holds the factor dt
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for schedule(static, 256) num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
+			{
+				float stiffnessI = mStiffness[i];
+				glm::vec3 correction = glm::vec3(0.0f);
+				for (int e = mPairOffsets[i]; e < mPairOffsets[i + 1]; e++)
+				{
+					correction += (stiffnessI + mStiffness[mPairIndices[e]]) * mPairGradients[e];
+				}
+				p.setVelocity(i, p.velocity(i) - correction);
+			}
+		}
+
+		void DFSPH3d::correctDivergenceError(float dt)
+		{
+			int iterations = 0;
+			float error = densitySourceTerm(dt, true);
+			while ((error > Lagrangian3dPara::divergenceTolerance || iterations < MIN_DIVERGENCE_ITERATIONS) &&
+				   iterations < Lagrangian3dPara::maxPressureIterations)
+			{
+				correctVelocities();
+				iterations++;
+				error = densitySourceTerm(dt, true);
+			}
+			divergenceIterations = iterations;
+			divergenceError = error;
+		}
+
+		void DFSPH3d::correctDensityError(float dt)
+		{
+			int iterations = 0;
+			float error = densitySourceTerm(dt, false);
+			while ((error > Lagrangian3dPara::densityTolerance || iterations < MIN_DENSITY_ITERATIONS) &&
+				   iterations < Lagrangian3dPara::maxPressureIterations)
+			{
+				correctVelocities();
+				iterations++;
+				error = densitySourceTerm(dt, false);
+			}
+			densityIterations = iterations;
+			densityError = error;
+		}
+	}
+}
@@ -1,4 +1,8 @@
 #include "Lagrangian3dComponent.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 namespace FluidSimulation
 {
@@ -25,23 +29,147 @@ namespace FluidSimulation
             renderer->init();
 
             ps = new ParticleSystem3d();
-            ps->setContainerSize(glm::vec3(0.0, 0.0, 0.0), glm::vec3(1, 1, 1));
-            ps->addFluidBlock(glm::vec3(0.05, 0.05, 0.3 ), glm::vec3(0.4, 0.4, 0.5), glm::vec3(0.0, 0.0, -1.0), 0.02);
-            ps->addFluidBlock(glm::vec3(0.45, 0.45, 0.3), glm::vec3(0.4, 0.4, 0.5), glm::vec3(0.0, 0.0, -1.0), 0.02);
-
+            createScene(*ps);
+            ps->reserve(Lagrangian3dPara::maxParticleNum);
             ps->updateBlockInfo();
-            std::cout << "particle num = " << ps->particles.size() << std::endl;
+            Lagrangian3dPara::particleNum = ps->mParticles.size();
+            std::fill(Lagrangian3dPara::particleNumHistory, Lagrangian3dPara::particleNumHistory + Lagrangian3dPara::PARTICLE_NUM_HISTORY, 0.0f);
+            Lagrangian3dPara::particleNumHistoryOffset = 0;
+            std::cout << "particle num = " << ps->mParticles.size() << std::endl;
 
             solver = new Solver(*ps);
         }
 
+        void Lagrangian3dComponent::createScene(ParticleSystem3d &ps)
+        {
+            ps.setContainerSize(glm::vec3(0.0, 0.0, 0.0), glm::vec3(1, 1, 1));
+            ps.addFluidBlock(glm::vec3(0.05, 0.05, 0.3 ), glm::vec3(0.4, 0.4, 0.5), glm::vec3(0.0, 0.0, -1.0), 0.02);
+            ps.addFluidBlock(glm::vec3(0.45, 0.45, 0.3), glm::vec3(0.4, 0.4, 0.5), glm::vec3(0.0, 0.0, -1.0), 0.02);
+            if (Lagrangian3dPara::emitters)
+            {
+                // a nozzle above the corner without fluid, a drain in the opposite corner of the floor
+                ps.addEmitter(glm::vec3(0.7, 0.2, 0.85), glm::vec3(0.0, 0.0, -1.5), 0.1, 0.02);
+                ps.addSink(glm::vec3(0.0, 0.8, -0.1), glm::vec3(0.2, 0.3, 0.15));
+            }
+        }
+
         void Lagrangian3dComponent::simulate()
         {
-            for (int i = 0; i < Lagrangian3dPara::substep; i++)
+            if (Lagrangian3dPara::benchmarkPressureSolver)
+            {
+                Lagrangian3dPara::benchmarkPressureSolver = false;
+                benchmarkPressureSolvers();
+            }
+
+            double emissionMs = 0.0;
+            if (!Lagrangian3dPara::adaptiveTimeStep)
+            {
+                for (int i = 0; i < Lagrangian3dPara::substep; i++)
+                {
+                    ps->updateBlockInfo();
+                    float dt = solver->solve();
+                    emissionMs += updateEmitters(dt);
+                }
+            }
+            else
+            {
+                // as many steps as the chosen dt needs to advance frameTime
+                float timeLeft = Lagrangian3dPara::frameTime;
+                int steps = 0;
+                while (timeLeft > 0.0f)
+                {
+                    ps->updateBlockInfo();
+                    float dt = solver->solve(timeLeft);
+                    emissionMs += updateEmitters(dt);
+                    timeLeft = dt < timeLeft ? timeLeft - dt : 0.0f;
+                    steps++;
+                }
+                Lagrangian3dPara::frameSteps = steps;
+            }
+
+            // removed particles are only cut off by the next sort, count the ones still alive
+            int particleNum = 0;
+            const std::vector<uint32_t> &blockId = ps->mParticles.blockId;
+#pragma omp parallel for reduction(+ : particleNum)
+            for (int i = 0; i < (int)blockId.size(); i++)
+            {
+                particleNum += blockId[i] != ParticleSystem3d::REMOVED_BLOCK_ID;
+            }
+            Lagrangian3dPara::particleNum = particleNum;
+            Lagrangian3dPara::emissionTime = emissionMs;
+            int &offset = Lagrangian3dPara::particleNumHistoryOffset;
+            Lagrangian3dPara::particleNumHistory[offset] = particleNum;
+            offset = (offset + 1) % Lagrangian3dPara::PARTICLE_NUM_HISTORY;
+        }
+
+        double Lagrangian3dComponent::updateEmitters(float dt)
+        {
+            if (ps->mEmitters.empty() && ps->mSinks.empty())
+            {
+                return 0.0;
+            }
+            Glb::Timer::getInstance().start();
+            auto start = std::chrono::steady_clock::now();
+            ps->updateEmitters(dt);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            Glb::Timer::getInstance().recordTime("emitters and sinks");
+            return ms;
+        }
+
+        void Lagrangian3dComponent::benchmarkPressureSolvers()
+        {
+            // both solvers simulate BENCHMARK_TIME of the initial scene, which covers the
+            // fall and the impact of the blocks. The equation of state runs with the step
+            // settings of the inspector, DFSPH always with the adaptive step since it has
+            // no stiffness to keep dt small. The compression is the time average of the
+            // mean max(rho - rho0, 0) / rho0
+            const float BENCHMARK_TIME = 0.5f;
+            const char *names[] = {"equation of state", "DFSPH"};
+            int pressureSolver = Lagrangian3dPara::pressureSolver;
+            bool adaptive = Lagrangian3dPara::adaptiveTimeStep;
+            for (int mode = 0; mode < 2; mode++)
             {
-                ps->updateBlockInfo();
-                solver->solve();
+                Lagrangian3dPara::pressureSolver = mode;
+                Lagrangian3dPara::adaptiveTimeStep = adaptive || mode == 1;
+
+                ParticleSystem3d benchPs;
+                createScene(benchPs);
+                benchPs.updateBlockInfo();
+                Solver benchSolver(benchPs);
+                ParticleArrays3d &p = benchPs.mParticles;
+                int particleNum = p.size();
+
+                int steps = 0;
+                double compression = 0.0;
+                double simulated = 0.0;
+                auto start = std::chrono::steady_clock::now();
+                while (simulated < BENCHMARK_TIME)
+                {
+                    if (steps > 0)
+                    {
+                        benchPs.updateBlockInfo();
+                    }
+                    float dt = Lagrangian3dPara::adaptiveTimeStep ? benchSolver.solve(BENCHMARK_TIME - simulated) : benchSolver.solve();
+                    simulated += dt;
+                    steps++;
+
+                    double sum = 0.0;
+#pragma omp parallel for reduction(+ : sum)
+                    for (int i = 0; i < particleNum; i++)
+                    {
+                        sum += max(p.density[i] - Lagrangian3dPara::density, 0.0f);
+                    }
+                    compression += dt * sum / particleNum;
+                }
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                char message[256];
+                snprintf(message, sizeof(message), "%s: %.0f ms per simulated second, %d steps of %.5f s on average, compression %.3f%%",
+                         names[mode], ms / simulated, steps, simulated / steps, 100.0 * compression / (simulated * Lagrangian3dPara::density));
+                Glb::Logger::getInstance().addLog(message);
             }
+            Lagrangian3dPara::pressureSolver = pressureSolver;
+            Lagrangian3dPara::adaptiveTimeStep = adaptive;
         }
 
         GLuint Lagrangian3dComponent::getRenderedTexture()
@@ -50,6 +178,7 @@ namespace FluidSimulation
             {
                 Glb::Timer::getInstance().start();
             }
+            ps->updateRenderView();
             renderer->load(*ps);
             renderer->draw();
             if (simulating)
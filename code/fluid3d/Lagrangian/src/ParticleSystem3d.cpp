@@ -1,12 +1,100 @@
 ﻿#include "ParticleSystem3d.h"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <Global.h>
+#include <omp.h>
+#include "Logger.h"
 
 namespace FluidSimulation
 {
     namespace Lagrangian3d
     {
+        template <typename T>
+        static void gather(std::vector<T> &data, const std::vector<uint32_t> &order, std::vector<T> &scratch)
+        {
+            int n = order.size();
+            scratch.resize(n);
+#pragma omp parallel for
+            for (int i = 0; i < n; i++)
+            {
+                scratch[i] = data[order[i]];
+            }
+            data.swap(scratch);
+        }
+
+        void ParticleArrays3d::clear()
+        {
+            resize(0);
+        }
+
+        void ParticleArrays3d::resize(int n)
+        {
+            posX.resize(n);
+            posY.resize(n);
+            posZ.resize(n);
+            velX.resize(n);
+            velY.resize(n);
+            velZ.resize(n);
+            accX.resize(n);
+            accY.resize(n);
+            accZ.resize(n);
+            density.resize(n);
+            pressure.resize(n);
+            pressDivDens2.resize(n);
+            blockId.resize(n);
+        }
+
+        void ParticleArrays3d::reserve(int n)
+        {
+            posX.reserve(n);
+            posY.reserve(n);
+            posZ.reserve(n);
+            velX.reserve(n);
+            velY.reserve(n);
+            velZ.reserve(n);
+            accX.reserve(n);
+            accY.reserve(n);
+            accZ.reserve(n);
+            density.reserve(n);
+            pressure.reserve(n);
+            pressDivDens2.reserve(n);
+            blockId.reserve(n);
+            // 重排时缓冲与数组交换，两者的容量都要预留
+            mScratch.reserve(n);
+            mScratchId.reserve(n);
+        }
+
+        void ParticleArrays3d::reorder(const std::vector<uint32_t> &order, bool fields)
+        {
+            // 每个数组按排列收集到缓冲中再交换，只搬动实际存在的分量
+            gather(posX, order, mScratch);
+            gather(posY, order, mScratch);
+            gather(posZ, order, mScratch);
+            gather(velX, order, mScratch);
+            gather(velY, order, mScratch);
+            gather(velZ, order, mScratch);
+            gather(blockId, order, mScratchId);
+            // 加速度、密度和压力在每一步开始时重新计算，不需要重排
+            // 休眠的粒子保留入睡时的密度和压力，相邻的粒子还要读取它们
+            if (fields)
+            {
+                gather(density, order, mScratch);
+                gather(pressure, order, mScratch);
+                gather(pressDivDens2, order, mScratch);
+            }
+        }
+
+        void NeighborList3d::clear()
+        {
+            offsets.clear();
+            indices.clear();
+            refPosition.clear();
+            distance.clear();
+            kernel.clear();
+        }
+
         ParticleSystem3d::ParticleSystem3d()
         {
         }
@@ -33,21 +121,16 @@ namespace FluidSimulation
             // 一个block的大小
             mBlockSize = glm::vec3(size.x / mBlockNum.x, size.y / mBlockNum.y, size.z / mBlockNum.z);
 
-            mBlockIdOffs.resize(27);
-            int p = 0;
-            for (int k = -1; k <= 1; k++)
-            {
-                for (int j = -1; j <= 1; j++)
-                {
-                    for (int i = -1; i <= 1; i++)
-                    {
-                        mBlockIdOffs[p] = mBlockNum.x * mBlockNum.y * k + mBlockNum.x * j + i;
-                        p++;
-                    }
-                }
-            }
+            setBlockOrder();
 
+            mParticles.clear();
             particles.clear();
+            mNeighborList.clear();
+            mEmitters.clear();
+            mSinks.clear();
+            mRemoved = false;
+            mBlockSleeping.clear();
+            mSleeping.clear();
         }
 
         int32_t ParticleSystem3d::addFluidBlock(glm::vec3 corner, glm::vec3 size, glm::vec3 v0, float particleSpace)
@@ -70,48 +153,194 @@ namespace FluidSimulation
             }
 
             glm::uvec3 particleNum = glm::uvec3(size.x / particleSpace, size.y / particleSpace, size.z / particleSpace);
-            std::vector<particle3d> tempParticles(particleNum.x * particleNum.y * particleNum.z);
+            int first = mParticles.size();
+            int blockParticleNum = particleNum.x * particleNum.y * particleNum.z;
+            mParticles.resize(first + blockParticleNum);
+
+            // 每个粒子的随机偏移只取决于种子和粒子编号，并行生成的场景与顺序生成的相同
+            Glb::CounterRandom rand(Lagrangian3dPara::seed);
+#pragma omp parallel for
+            for (int n = 0; n < blockParticleNum; n++)
+            {
+                int idX = n / (particleNum.y * particleNum.z);
+                int idY = n / particleNum.z % particleNum.y;
+                int idZ = n % particleNum.z;
+                int p = first + n;
+                float x = (idX + rand.GetUniform(3 * (uint64_t)p)) * particleSpace;
+                float y = (idY + rand.GetUniform(3 * (uint64_t)p + 1)) * particleSpace;
+                float z = (idZ + rand.GetUniform(3 * (uint64_t)p + 2)) * particleSpace;
+                glm::vec3 position = corner + glm::vec3(x, y, z);
+                mParticles.setPosition(p, position);
+                mParticles.setVelocity(p, v0);
+                mParticles.blockId[p] = getBlockIdByPosition(position);
+            }
+
+            return mParticles.size();
+        }
+
+        void ParticleSystem3d::addEmitter(glm::vec3 center, glm::vec3 velocity, float size, float particleSpace)
+        {
+            if (glm::length(velocity) <= 0.0f)
+            {
+                return;
+            }
+            Emitter3d emitter;
+            emitter.center = center * Lagrangian3dPara::scale;
+            emitter.velocity = velocity;
+            emitter.size = size * Lagrangian3dPara::scale;
+            emitter.particleSpace = particleSpace;
+            mEmitters.push_back(emitter);
+        }
+
+        void ParticleSystem3d::addSink(glm::vec3 corner, glm::vec3 size)
+        {
+            Sink3d sink;
+            sink.lower = corner * Lagrangian3dPara::scale;
+            sink.upper = sink.lower + size * Lagrangian3dPara::scale;
+            mSinks.push_back(sink);
+        }
+
+        void ParticleSystem3d::reserve(int capacity)
+        {
+            mCapacity = max(capacity, mParticles.size());
+            mParticles.reserve(mCapacity);
+            particles.reserve(mCapacity);
+            mSortOrder.reserve(mCapacity);
+        }
 
-            Glb::RandomGenerator rand;
-            int p = 0;
-            for (int idX = 0; idX < particleNum.x; idX++)
+        int ParticleSystem3d::updateEmitters(float dt)
+        {
+            // 粒子汇只标记粒子，截掉被标记的粒子由 updateBlockInfo() 中本来就要做的排序完成，不需要额外搬动数组
+            int sinkNum = mSinks.size();
+            if (sinkNum > 0)
             {
-                for (int idY = 0; idY < particleNum.y; idY++)
+                int particleNum = mParticles.size();
+                int removed = 0;
+#pragma omp parallel for reduction(+ : removed)
+                for (int i = 0; i < particleNum; i++)
                 {
-                    for (int idZ = 0; idZ < particleNum.z; idZ++)
+                    glm::vec3 position = mParticles.position(i);
+                    for (int s = 0; s < sinkNum && mParticles.blockId[i] != REMOVED_BLOCK_ID; s++)
                     {
-                        float x = (idX + rand.GetUniformRandom()) * particleSpace;
-                        float y = (idY + rand.GetUniformRandom()) * particleSpace;
-                        float z = (idZ + rand.GetUniformRandom()) * particleSpace;
-                        tempParticles[p].position = corner + glm::vec3(x, y, z);
-                        tempParticles[p].blockId = getBlockIdByPosition(tempParticles[p].position);
-                        tempParticles[p].velocity = v0;
-                        p++;
+                        if (glm::all(glm::greaterThanEqual(position, mSinks[s].lower)) &&
+                            glm::all(glm::lessThanEqual(position, mSinks[s].upper)))
+                        {
+                            mParticles.blockId[i] = REMOVED_BLOCK_ID;
+                            removed++;
+                        }
                     }
                 }
+                mRemoved = mRemoved || removed > 0;
             }
 
-            particles.insert(particles.end(), tempParticles.begin(), tempParticles.end());
-            return particles.size();
+            // 新粒子追加在数组末尾，下一次 updateBlockInfo() 的排序把它们放进各自的block
+            int emitted = 0;
+            for (int e = 0; e < mEmitters.size(); e++)
+            {
+                Emitter3d &emitter = mEmitters[e];
+                float speed = glm::length(emitter.velocity);
+                glm::vec3 direction = emitter.velocity / speed;
+                glm::vec3 axis = std::abs(direction.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::vec3 tangent = glm::normalize(glm::cross(direction, axis));
+                glm::vec3 bitangent = glm::cross(direction, tangent);
+                int side = max((int)(emitter.size / emitter.particleSpace), 1);
+                int layerNum = side * side;
+
+                // 每个粒子源的随机数占用自己的一段计数器，与 addFluidBlock 的不重叠
+                Glb::CounterRandom rand(Lagrangian3dPara::seed);
+                uint64_t counterBase = (uint64_t)(e + 1) << 40;
+
+                emitter.travel += speed * dt;
+                while (emitter.travel >= emitter.particleSpace)
+                {
+                    emitter.travel -= emitter.particleSpace;
+                    int first = mParticles.size();
+                    if (first + layerNum > mCapacity)
+                    {
+                        // 池满时丢弃这一步的流量而不是扩大数组，等粒子汇腾出空间
+                        emitter.travel = 0.0f;
+                        if (!mPoolFull)
+                        {
+                            char message[128];
+                            snprintf(message, sizeof(message), "Particle pool full (%d particles), emitters paused", mCapacity);
+                            Glb::Logger::getInstance().addLog(message);
+                            mPoolFull = true;
+                        }
+                        break;
+                    }
+                    mPoolFull = false;
+
+                    // 这一层在 travel 之前射出，已经沿 velocity 前进了 travel
+                    mParticles.resize(first + layerNum);
+                    for (int n = 0; n < layerNum; n++)
+                    {
+                        uint64_t counter = counterBase + 2 * (emitter.emitted + n);
+                        float u = ((n / side + 0.5f) / side - 0.5f) * emitter.size + rand.GetUniform(counter, -0.05f, 0.05f) * emitter.particleSpace;
+                        float v = ((n % side + 0.5f) / side - 0.5f) * emitter.size + rand.GetUniform(counter + 1, -0.05f, 0.05f) * emitter.particleSpace;
+                        glm::vec3 position = emitter.center + u * tangent + v * bitangent + emitter.travel * direction;
+                        int p = first + n;
+                        mParticles.setPosition(p, position);
+                        mParticles.setVelocity(p, emitter.velocity);
+                        mParticles.blockId[p] = getBlockIdByPosition(position);
+                    }
+                    emitter.emitted += layerNum;
+                    emitted += layerNum;
+                }
+            }
+            return emitted;
         }
 
         uint32_t ParticleSystem3d::getBlockIdByPosition(glm::vec3 position)
         {
-            if (position.x < mLowerBound.x ||
-                position.y < mLowerBound.y ||
-                position.z < mLowerBound.z ||
-                position.x > mUpperBound.x ||
-                position.y > mUpperBound.y ||
-                position.z > mUpperBound.z)
+            // 稀疏网格不受容器大小的限制，容器外的粒子同样落在某个槽位
+            if (!mSparseGrid &&
+                (position.x < mLowerBound.x ||
+                 position.y < mLowerBound.y ||
+                 position.z < mLowerBound.z ||
+                 position.x > mUpperBound.x ||
+                 position.y > mUpperBound.y ||
+                 position.z > mUpperBound.z))
             {
                 return -1;
             }
 
-            glm::vec3 deltePos = position - mLowerBound;
-            uint32_t c = floor(deltePos.x / mBlockSize.x);
-            uint32_t r = floor(deltePos.y / mBlockSize.y);
-            uint32_t h = floor(deltePos.z / mBlockSize.z);
-            return h * mBlockNum.x * mBlockNum.y + r * mBlockNum.x + c;
+            return getCellBlock(getCell(position));
+        }
+
+        void ParticleSystem3d::setBlockOrder()
+        {
+            // 行优先编号下 y、z 方向相邻的block在排序后的粒子数组中相距很远
+            // Morton（Z序）编号让空间上相邻的block在数组中也大多相邻，遍历邻域时访问的内存更集中
+            // Morton 码每个方向用 10 位，block 数超出时退回行优先
+            // 稀疏网格只为粒子数量分配哈希表，与容器的大小无关，适合大部分是空气的高水箱和开放场景
+            mBlockOrder = Lagrangian3dPara::blockOrder;
+            mSparseGrid = Lagrangian3dPara::sparseGrid;
+            mBlockSleeping.clear(); // 编号改变后休眠状态失效，所有 block 从唤醒状态重新计数
+            if (mSparseGrid)
+            {
+                mMortonOrder = false;
+                mBlockIdNum = sparseTableSize();
+                return;
+            }
+            mMortonOrder = mBlockOrder == 1 && mBlockNum.x <= 1024 && mBlockNum.y <= 1024 && mBlockNum.z <= 1024;
+            mBlockIdNum = getBlockId(mBlockNum - glm::uvec3(1)) + 1;
+        }
+
+        uint32_t ParticleSystem3d::sparseTableSize() const
+        {
+            // 不小于粒子数两倍的 2 的幂，槽位平均不到半个单元格
+            // 当前大小仍在粒子数的 2 到 8 倍之间时保持不变，避免粒子数小幅变化时反复重建
+            uint32_t particleNum = mParticles.size();
+            if (mSparseGrid && mBlockIdNum >= 2 * particleNum && mBlockIdNum <= 8 * particleNum)
+            {
+                return mBlockIdNum;
+            }
+            uint32_t size = 1024;
+            while (size < 2 * particleNum)
+            {
+                size *= 2;
+            }
+            return size;
         }
 
         void ParticleSystem3d::updateBlockInfo()
@@ -121,27 +350,344 @@ namespace FluidSimulation
             // 排序前要求各个粒子的blockID已经被正确更新
             // 在addFluidBlock中，对粒子的blockID初始化
             // 之后的模拟过程中，Slover::calculateBlockId()用来更新blockID
-            std::sort(particles.begin(), particles.end(),
-                      [=](particle3d &first, particle3d &second)
-                      {
-                          return first.blockId < second.blockId;
-                      });
-
-            // 更新每个block在排序后的粒子数组中的起始和结束索引
-            mBlockExtens = std::vector<glm::uvec2>(mBlockNum.x * mBlockNum.y * mBlockNum.z, glm::uvec2(0, 0));
-            int curBlockId = 0;
-            int left = 0;
-            int right;
-            for (right = 0; right < particles.size(); right++)
-            {
-                if (particles[right].blockId != curBlockId)
+            if (Lagrangian3dPara::blockOrder != mBlockOrder || Lagrangian3dPara::sparseGrid != mSparseGrid ||
+                (mSparseGrid && sparseTableSize() != mBlockIdNum))
+            {
+                // 编号方式或哈希表大小改变后按位置重新计算所有粒子的blockId
+                setBlockOrder();
+                int particleNum = mParticles.size();
+#pragma omp parallel for
+                for (int i = 0; i < particleNum; i++)
                 {
-                    mBlockExtens[curBlockId] = glm::uvec2(left, right); // 左闭右开
-                    left = right;
-                    curBlockId = particles[right].blockId;
+                    if (mParticles.blockId[i] != REMOVED_BLOCK_ID)
+                    {
+                        mParticles.blockId[i] = getBlockIdByPosition(mParticles.position(i));
+                    }
                 }
             }
-            mBlockExtens[curBlockId] = glm::uvec2(left, right);
+
+            if (Lagrangian3dPara::benchmarkBlockSort)
+            {
+                Lagrangian3dPara::benchmarkBlockSort = false;
+                benchmarkBlockSort();
+            }
+
+            // 邻居表仍然有效时不重排粒子，表中的下标保持不变
+            // 有粒子被删除时必须排序；射出的粒子改变了粒子数，邻居表本来就失效
+            if (!Lagrangian3dPara::neighborList)
+            {
+                mNeighborList.clear();
+            }
+            else if (!mRemoved && neighborListValid())
+            {
+                return;
+            }
+
+            // blockId 是有界的小整数，用并行计数排序求出排列，同时得到每个block在排序后的粒子数组中的起止索引（左闭右开）
+            // 再按排列一次性重排各个分量数组
+            mBlockSort.sort(mParticles.blockId, mBlockIdNum, Lagrangian3dPara::threads, mSortOrder, mBlockExtens);
+            mParticles.reorder(mSortOrder, !mBlockSleeping.empty());
+
+            // blockId 超出范围的粒子（被粒子汇删除的，以及稠密网格下跑出容器的）排在最后一个block之后，
+            // 截掉它们就完成了粒子池的压缩，数组的容量不变
+            int aliveNum = mBlockIdNum > 0 ? mBlockExtens[mBlockIdNum - 1].y : 0;
+            if (aliveNum < mParticles.size())
+            {
+                mParticles.resize(aliveNum);
+            }
+            mRemoved = false;
+
+            if (Lagrangian3dPara::neighborList)
+            {
+                buildNeighborList();
+            }
+        }
+
+        void ParticleSystem3d::updateSleepingBlocks(bool enabled)
+        {
+            int particleNum = mParticles.size();
+            if (!enabled)
+            {
+                // 休眠的粒子速度为 0，唤醒后从静止开始继续模拟
+                mBlockSleeping.clear();
+                mSleeping.clear();
+                mActiveNum = particleNum;
+                return;
+            }
+            int blockNum = mBlockIdNum;
+            if (mBlockSleeping.size() != blockNum)
+            {
+                mBlockSleeping.assign(blockNum, 0);
+                mBlockActive.assign(blockNum, 0);
+                mBlockCalmSteps.assign(blockNum, 0);
+            }
+
+            // 1. 含有速度或加速度超过阈值的粒子的 block 是活跃的。休眠的粒子速度和加速度为 0，
+            // 休眠的 block 只会因为有运动的粒子进入而变得活跃
+            // 邻居表有效时粒子不重排，mBlockExtens 仍是建表时的划分，粒子最多离开原来的 block 半个 skin
+            float velocity2 = Lagrangian3dPara::sleepVelocity * Lagrangian3dPara::sleepVelocity;
+            float accleration2 = Lagrangian3dPara::sleepAccleration * Lagrangian3dPara::sleepAccleration;
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int b = 0; b < blockNum; b++)
+            {
+                glm::uvec2 extent = mBlockExtens[b];
+                bool active = false;
+                for (int i = extent.x; i < extent.y && !active; i++)
+                {
+                    float v2 = mParticles.velX[i] * mParticles.velX[i] + mParticles.velY[i] * mParticles.velY[i] + mParticles.velZ[i] * mParticles.velZ[i];
+                    float a2 = mParticles.accX[i] * mParticles.accX[i] + mParticles.accY[i] * mParticles.accY[i] + mParticles.accZ[i] * mParticles.accZ[i];
+                    active = v2 > velocity2 || a2 > accleration2;
+                }
+                mBlockActive[b] = active;
+            }
+
+            // 2. 自身和相邻 block 都不活跃时累计步数，达到 sleepSteps 后休眠；否则立即唤醒并重新计数
+            // 活跃的 block 只唤醒相邻的 block，唤醒的 block 中的粒子动起来之后才会继续向外唤醒
+            // 稀疏网格下一个槽位可能含有几个单元格，每换一个单元格就重新检查它的相邻 block，
+            // 否则槽位中远离第一个粒子的单元格会在活跃的 block 旁边休眠
+            int sleepSteps = Lagrangian3dPara::sleepSteps;
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int b = 0; b < blockNum; b++)
+            {
+                glm::uvec2 extent = mBlockExtens[b];
+                bool quiet = extent.x < extent.y && !mBlockActive[b];
+                glm::ivec3 checkedCell(-1);
+                for (int i = extent.x; i < extent.y && quiet; i++)
+                {
+                    glm::ivec3 cell = getCell(mParticles.position(i));
+                    if (i == extent.x || cell != checkedCell)
+                    {
+                        checkedCell = cell;
+                        int32_t neighbors[NEIGHBOR_BLOCK_NUM];
+                        getNeighborBlocks(cell, neighbors);
+                        for (int k = 0; k < NEIGHBOR_BLOCK_NUM && quiet; k++)
+                        {
+                            quiet = neighbors[k] < 0 || !mBlockActive[neighbors[k]];
+                        }
+                    }
+                }
+                if (!quiet)
+                {
+                    mBlockCalmSteps[b] = 0;
+                    mBlockSleeping[b] = 0;
+                }
+                else if (!mBlockSleeping[b] && ++mBlockCalmSteps[b] >= sleepSteps)
+                {
+                    mBlockSleeping[b] = 1;
+                }
+            }
+
+            // 3. 粒子按所在的 block 标记，休眠的粒子速度和加速度清零
+            // 相邻的 block 都在休眠或没有粒子时标记为 2，Solver 完全跳过这些粒子，不再逐个查找相邻的 block
+            // 与第 2 步一样按单元格检查相邻的 block
+            mSleeping.assign(particleNum, 0);
+            int activeNum = particleNum;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+ : activeNum)
+            for (int b = 0; b < blockNum; b++)
+            {
+                if (!mBlockSleeping[b])
+                {
+                    continue;
+                }
+                glm::uvec2 extent = mBlockExtens[b];
+                bool inside = true;
+                glm::ivec3 checkedCell(-1);
+                for (int i = extent.x; i < extent.y && inside; i++)
+                {
+                    glm::ivec3 cell = getCell(mParticles.position(i));
+                    if (i == extent.x || cell != checkedCell)
+                    {
+                        checkedCell = cell;
+                        int32_t neighbors[NEIGHBOR_BLOCK_NUM];
+                        getNeighborBlocks(cell, neighbors);
+                        for (int k = 0; k < NEIGHBOR_BLOCK_NUM && inside; k++)
+                        {
+                            int32_t block = neighbors[k];
+                            inside = block < 0 || mBlockSleeping[block] || mBlockExtens[block].x == mBlockExtens[block].y;
+                        }
+                    }
+                }
+                for (int i = extent.x; i < extent.y; i++)
+                {
+                    mSleeping[i] = inside ? 2 : 1;
+                    mParticles.setVelocity(i, glm::vec3(0.0f));
+                    mParticles.accX[i] = mParticles.accY[i] = mParticles.accZ[i] = 0.0f;
+                }
+                activeNum -= extent.y - extent.x;
+            }
+            mActiveNum = activeNum;
+        }
+
+        bool ParticleSystem3d::useNeighborList() const
+        {
+            return Lagrangian3dPara::neighborList && mNeighborList.offsets.size() == mParticles.size() + 1;
+        }
+
+        bool ParticleSystem3d::neighborListValid() const
+        {
+            const NeighborList3d &list = mNeighborList;
+            int particleNum = mParticles.size();
+            if (list.offsets.size() != particleNum + 1 || list.skin != Lagrangian3dPara::neighborSkin)
+            {
+                return false;
+            }
+
+            // 最大位移超过 skin 的一半时，两个粒子可能从候选半径之外进入支撑半径
+            float limit = 0.5f * list.skin * mSupportRadius;
+            float limit2 = limit * limit;
+            bool valid = true;
+#pragma omp parallel for reduction(&& : valid)
+            for (int i = 0; i < particleNum; i++)
+            {
+                glm::vec3 move = mParticles.position(i) - list.refPosition[i];
+                valid = valid && glm::dot(move, move) <= limit2;
+            }
+            return valid;
+        }
+
+        void ParticleSystem3d::buildNeighborList()
+        {
+            // 调用前粒子已按 block 排好序
+            // 候选半径大于 block 的大小，所以每个粒子按自己的位置求出候选球覆盖的 block 范围
+            NeighborList3d &list = mNeighborList;
+            int particleNum = mParticles.size();
+            list.skin = Lagrangian3dPara::neighborSkin;
+            float radius = mSupportRadius * (1.0f + list.skin);
+            float radius2 = radius * radius;
+            glm::ivec3 maxCell = glm::ivec3(mBlockNum) - 1;
+
+            // 每个线程处理一段连续的粒子，下标先写入线程自己的缓冲，前缀和之后整段拷贝到 indices
+            list.offsets.resize(particleNum + 1);
+            list.offsets[0] = 0;
+            list.threadIndices.resize(omp_get_max_threads());
+            list.threadBlocks.resize(omp_get_max_threads());
+#pragma omp parallel
+            {
+                int thread = omp_get_thread_num();
+                int threadNum = omp_get_num_threads();
+                int begin = (long long)particleNum * thread / threadNum;
+                int end = (long long)particleNum * (thread + 1) / threadNum;
+                std::vector<uint32_t> &indices = list.threadIndices[thread];
+                std::vector<int32_t> &blocks = list.threadBlocks[thread];
+                indices.clear();
+                for (int i = begin; i < end; i++)
+                {
+                    glm::vec3 positionI = mParticles.position(i);
+                    glm::ivec3 lower = getCell(positionI - radius);
+                    glm::ivec3 upper = getCell(positionI + radius);
+                    if (!mSparseGrid)
+                    {
+                        lower = glm::clamp(lower, glm::ivec3(0), maxCell);
+                        upper = glm::clamp(upper, glm::ivec3(0), maxCell);
+                    }
+
+                    // 稀疏网格下几个单元格可能共用一个槽位，每个槽位只遍历一次
+                    blocks.clear();
+                    for (int h = lower.z; h <= upper.z; h++)
+                    {
+                        for (int r = lower.y; r <= upper.y; r++)
+                        {
+                            for (int c = lower.x; c <= upper.x; c++)
+                            {
+                                int32_t block = getCellBlock(glm::ivec3(c, r, h));
+                                if (!mSparseGrid || std::find(blocks.begin(), blocks.end(), block) == blocks.end())
+                                {
+                                    blocks.push_back(block);
+                                }
+                            }
+                        }
+                    }
+
+                    uint32_t count = indices.size();
+                    for (int b = 0; b < blocks.size(); b++)
+                    {
+                        glm::uvec2 extent = mBlockExtens[blocks[b]];
+                        for (int j = extent.x; j < extent.y; j++)
+                        {
+                            glm::vec3 radiusIj = positionI - mParticles.position(j);
+                            if (glm::dot(radiusIj, radiusIj) <= radius2)
+                            {
+                                indices.push_back(j);
+                            }
+                        }
+                    }
+                    list.offsets[i + 1] = indices.size() - count;
+                }
+
+#pragma omp barrier
+#pragma omp single
+                {
+                    for (int i = 0; i < particleNum; i++)
+                    {
+                        list.offsets[i + 1] += list.offsets[i];
+                    }
+                    list.indices.resize(list.offsets[particleNum]);
+                    list.distance.resize(list.indices.size());
+                    list.kernel.resize(list.indices.size());
+                    list.refPosition.resize(particleNum);
+                }
+
+                std::copy(indices.begin(), indices.end(), list.indices.begin() + list.offsets[begin]);
+                for (int i = begin; i < end; i++)
+                {
+                    list.refPosition[i] = mParticles.position(i);
+                }
+            }
+        }
+
+        void ParticleSystem3d::benchmarkBlockSort()
+        {
+            // 在当前粒子的blockId上分别计时原来的比较排序和计数排序，只求排列，不改变粒子数据
+            const std::vector<uint32_t> &blockId = mParticles.blockId;
+            int blockNum = mBlockIdNum;
+            const int repeats = 10;
+            std::vector<uint32_t> order;
+            std::vector<glm::uvec2> extents;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++)
+            {
+                order.resize(blockId.size());
+                for (int i = 0; i < order.size(); i++)
+                {
+                    order[i] = i;
+                }
+                std::stable_sort(order.begin(), order.end(),
+                                 [&](uint32_t first, uint32_t second)
+                                 {
+                                     return blockId[first] < blockId[second];
+                                 });
+            }
+            auto mid = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++)
+            {
+                mBlockSort.sort(blockId, blockNum, Lagrangian3dPara::threads, order, extents);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            double comparisonMs = std::chrono::duration<double, std::milli>(mid - start).count() / repeats;
+            double countingMs = std::chrono::duration<double, std::milli>(end - mid).count() / repeats;
+            char message[256];
+            snprintf(message, sizeof(message), "Block sort, %d particles in %d blocks: std::stable_sort %.3f ms, counting sort %.3f ms",
+                     mParticles.size(), blockNum, comparisonMs, countingMs);
+            Glb::Logger::getInstance().addLog(message);
+        }
+
+        void ParticleSystem3d::updateRenderView()
+        {
+            int n = mParticles.size();
+            particles.resize(n);
+#pragma omp parallel for
+            for (int i = 0; i < n; i++)
+            {
+                particles[i].position = mParticles.position(i);
+                particles[i].velocity = mParticles.velocity(i);
+                particles[i].accleration = glm::vec3(mParticles.accX[i], mParticles.accY[i], mParticles.accZ[i]);
+                particles[i].density = mParticles.density[i];
+                particles[i].pressure = mParticles.pressure[i];
+                particles[i].pressDivDens2 = mParticles.pressDivDens2[i];
+                particles[i].blockId = mParticles.blockId[i];
+            }
         }
 
     }
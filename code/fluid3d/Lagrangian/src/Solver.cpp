@@ -1,4 +1,5 @@
 #include "fluid3d/Lagrangian/include/Solver.h"
+#include "Logger.h"
 #include <omp.h>
 
 namespace FluidSimulation
@@ -6,7 +7,17 @@ namespace FluidSimulation
 
 	namespace Lagrangian3d
 	{
-		Solver::Solver(ParticleSystem3d &ps) : mPs(ps), mW(ps.mSupportRadius)
+		// threads of the per-particle loops, Lagrangian3dPara::threads or every core
+		static int numThreads()
+		{
+			return Lagrangian3dPara::threads > 0 ? Lagrangian3dPara::threads : omp_get_max_threads();
+		}
+
+		// particles per chunk handed out to a thread, neighbour counts vary a lot
+		// between the inside and the surface of the fluid so the chunks are dynamic
+		static const int PARTICLE_CHUNK = 64;
+
+		Solver::Solver(ParticleSystem3d &ps) : mPs(ps), mW(ps.mSupportRadius), mDfsph(ps, mW), mDt(Lagrangian3dPara::dt), mKernelsRequested(-1), mPairStreamsRecorded(false)
 		{
 
 		}
@@ -16,7 +27,7 @@ namespace FluidSimulation
 
 		}
 
-		void Solver::solve()
+		float Solver::solve(float timeLeft)
 		{
 			// TODO
 			// Solves the fluid simulation by performing some steps, which may include:
@@ -28,170 +39,535 @@ namespace FluidSimulation
 			// 6. update block id
 			// ...
 
+			selectKernels();
 			Glb::Timer::getInstance().start();
+			mPs.updateSleepingBlocks(Lagrangian3dPara::sleepingBlocks && Lagrangian3dPara::pressureSolver == 0);
+			Lagrangian3dPara::activeFraction = mPs.mParticles.size() > 0 ? (float)mPs.mActiveNum / mPs.mParticles.size() : 1.0f;
+			if (Lagrangian3dPara::pressureSolver == 1)
+			{
+				return solveDivergenceFree(timeLeft);
+			}
+
+			Glb::Timer::getInstance().recordTime("sleeping blocks");
 			computeDensityAndPress();
 			Glb::Timer::getInstance().recordTime("density and press");
 			computeAccleration();
 			Glb::Timer::getInstance().recordTime("compute acc");
+			mDt = Lagrangian3dPara::adaptiveTimeStep ? adaptiveTimeStep(timeLeft) : Lagrangian3dPara::dt;
 			eulerIntegration();
 			Glb::Timer::getInstance().recordTime("euler intergration");
 			boundaryCondition();
 			Glb::Timer::getInstance().recordTime("boundary check");
 			calculateBlockId();
 			Glb::Timer::getInstance().recordTime("renew block id");
+			return mDt;
 		}
 
-		void Solver::computeAccleration()
+		float Solver::solveDivergenceFree(float timeLeft)
+		{
+			// the step of DFSPH, starting where its paper ends one: the divergence solve
+			// runs on the new neighbourhood with the dt of the step that produced it
+			Glb::Timer::getInstance().start();
+			mDfsph.computeDensityAndFactor();
+			mDfsph.correctDivergenceError(mDt);
+			Glb::Timer::getInstance().recordTime("divergence solve");
+			computeAccleration();
+			Glb::Timer::getInstance().recordTime("compute acc");
+			mDt = Lagrangian3dPara::adaptiveTimeStep ? adaptiveTimeStep(timeLeft) : Lagrangian3dPara::dt;
+			integrateVelocity();
+			mDfsph.correctDensityError(mDt);
+			Glb::Timer::getInstance().recordTime("density solve");
+			integratePosition();
+			Glb::Timer::getInstance().recordTime("euler intergration");
+			boundaryCondition();
+			Glb::Timer::getInstance().recordTime("boundary check");
+			calculateBlockId();
+			Glb::Timer::getInstance().recordTime("renew block id");
+
+			Lagrangian3dPara::densityIterations = mDfsph.densityIterations;
+			Lagrangian3dPara::divergenceIterations = mDfsph.divergenceIterations;
+			Lagrangian3dPara::densityError = mDfsph.densityError;
+			return mDt;
+		}
+
+		float Solver::adaptiveTimeStep(float timeLeft)
+		{
+			// the largest step the fastest and the most accelerated particle allow:
+			//   CFL:       dt <= cflNumber * h / max|v|
+			//   force:     dt <= 0.25 * sqrt(h / max|a|)
+			//   viscosity: dt <= 0.125 * h^2 / viscosity
+			// clamped to [minDt, maxDt]. OpenMP 2.0 has no max reduction, so every thread
+			// keeps its own maxima and merges them once
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+			float maxVelocity2 = 0.0f;
+			float maxAccleration2 = 0.0f;
+#pragma omp parallel num_threads(numThreads())
+			{
+				float velocity2 = 0.0f;
+				float accleration2 = 0.0f;
+#pragma omp for
+				for (int i = 0; i < particleNum; i++)
+				{
+					velocity2 = max(velocity2, p.velX[i] * p.velX[i] + p.velY[i] * p.velY[i] + p.velZ[i] * p.velZ[i]);
+					accleration2 = max(accleration2, p.accX[i] * p.accX[i] + p.accY[i] * p.accY[i] + p.accZ[i] * p.accZ[i]);
+				}
+#pragma omp critical
+				{
+					maxVelocity2 = max(maxVelocity2, velocity2);
+					maxAccleration2 = max(maxAccleration2, accleration2);
+				}
+			}
+
+			float h = Lagrangian3dPara::supportRadius;
+			float dt = Lagrangian3dPara::maxDt;
+			if (maxVelocity2 > 0.0f)
+			{
+				dt = min(dt, Lagrangian3dPara::cflNumber * h / sqrt(maxVelocity2));
+			}
+			if (maxAccleration2 > 0.0f)
+			{
+				dt = min(dt, 0.25f * sqrt(h / sqrt(maxAccleration2)));
+			}
+			if (Lagrangian3dPara::viscosity > 0.0f)
+			{
+				dt = min(dt, 0.125f * h * h / Lagrangian3dPara::viscosity);
+			}
+			dt = max(dt, Lagrangian3dPara::minDt);
+			Lagrangian3dPara::stepDt = dt;
+
+			// end exactly on the frame, and split the remainder evenly rather than leave a sliver
+			if (timeLeft <= dt)
+			{
+				return timeLeft;
+			}
+			if (timeLeft < 2.0f * dt)
+			{
+				return 0.5f * timeLeft;
+			}
+			return dt;
+		}
+
+		void Solver::selectKernels()
+		{
+			if (mKernelsRequested == Lagrangian3dPara::simd)
+			{
+				return;
+			}
+			mKernelsRequested = Lagrangian3dPara::simd;
+			mKernels = SphKernels3d::select(Lagrangian3dPara::simd);
+			const char *names[] = {"scalar", "AVX2", "AVX-512"};
+			Glb::Logger::getInstance().addLog(std::string("SPH pair loops: ") + names[mKernels.isa]);
+		}
+
+		SphPairParams Solver::pairParams()
 		{
 			float dim = 3.0;
 			float constFactor = 2.0 * (dim + 2.0) * Lagrangian3dPara::viscosity;
-			for (int i = 0; i < mPs.particles.size(); i++)
+			SphPairParams params;
+			params.supportRadius = Lagrangian3dPara::supportRadius;
+			params.kernelTable = mW.GetData();
+			params.kernelTableSize = mW.GetBufferSize();
+			params.viscosityFactor = 0.5f * constFactor;
+			params.pressureFactor = mPs.mVolume;
+			params.denomEps = 0.01 * Lagrangian3dPara::supportRadius * Lagrangian3dPara::supportRadius;
+			return params;
+		}
+
+		void Solver::computeAccleration()
+		{
+			// every pair is evaluated once, from the side of its lower index i. The
+			// viscosity and pressure terms of j only differ from those of i in sign and
+			// in the density factor, so i sums its share locally and j's share goes to
+			// the buffer of the thread. The chunks are handed out statically and the
+			// buffers are added in thread order, so a given thread count always gives
+			// the same result
+			ParticleArrays3d &p = mPs.mParticles;
+			NeighborList3d &list = mPs.mNeighborList;
+			bool useList = mPs.useNeighborList();
+			bool useStreams = mPairStreamsRecorded;
+			mPairStreamsRecorded = false;
+			// a pair is skipped when both of its particles sleep, the share of a sleeping particle
+			// is dropped. Away from awake blocks a sleeping particle has no pair left to evaluate
+			const uint8_t *sleeping = mPs.mSleeping.empty() ? NULL : mPs.mSleeping.data();
+			const uint8_t *blockSleeping = sleeping ? mPs.mBlockSleeping.data() : NULL;
+			SphPairParams params = pairParams();
+			int particleNum = p.size();
+			int threadNum = numThreads();
+			int usedThreads = 1;
+			int streamNum = mPairStreams.size();
+			if (mThreadAcc.size() < threadNum)
+			{
+				mThreadAcc.resize(threadNum);
+			}
+#pragma omp parallel num_threads(threadNum)
 			{
+#pragma omp master
+				usedThreads = omp_get_num_threads();
 
-				mPs.particles[i].accleration = glm::vec3(-Lagrangian3dPara::gravityX, -Lagrangian3dPara::gravityY, -Lagrangian3dPara::gravityZ);
-				// std::cout << mPs.mParticleInfos[i].accleration.z << std::endl;
-				// update viscosity and pressure
-				glm::vec3 viscosityForce = glm::vec3(0.0);
-				glm::vec3 pressureForce = glm::vec3(0.0);
-				for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
+				int thread = omp_get_thread_num();
+				std::vector<float> &acc = mThreadAcc[thread];
+				acc.assign(3 * particleNum, 0.0f);
+				float *accX = acc.data();
+				float *accY = accX + particleNum;
+				float *accZ = accY + particleNum;
+				if (useStreams)
 				{
-					int bIdj = mPs.particles[i].blockId + mPs.mBlockIdOffs[k];
-					if (bIdj >= 0 && bIdj < mPs.mBlockExtens.size())
+					// every thread replays the stream it recorded, so the pairs are still in its cache
+					for (int t = thread; t < streamNum; t += omp_get_num_threads())
 					{
-						for (int j = mPs.mBlockExtens[bIdj].x; j < mPs.mBlockExtens[bIdj].y; j++)
+						const PairStream3d &stream = mPairStreams[t];
+						for (int i = stream.begin; i < stream.end; i++)
 						{
-							glm::vec3 radiusIj = mPs.particles[i].position - mPs.particles[j].position;
-							float diatanceIj = length(radiusIj);
-							if (diatanceIj <= Lagrangian3dPara::supportRadius)
+							glm::vec3 positionI = p.position(i);
+							glm::vec3 velocityI = p.velocity(i);
+							float densityI = p.density[i];
+							float pressDivDens2I = p.pressDivDens2[i];
+							glm::vec3 accI = glm::vec3(0.0f);
+							int first = stream.offsets[i - stream.begin];
+							int last = stream.offsets[i - stream.begin + 1];
+							for (int e = first; e < last; e++)
 							{
-								float dotDvToRad = glm::dot(mPs.particles[i].velocity - mPs.particles[j].velocity, radiusIj);
-								float denom = diatanceIj * diatanceIj + 0.01 * Lagrangian3dPara::supportRadius * Lagrangian3dPara::supportRadius;
-								glm::vec3 wGrad = mW.GetGrad(diatanceIj / Lagrangian3dPara::supportRadius).g * radiusIj;
-								// std::cout << wGrad.z << std::endl;
-								viscosityForce += (float)(0.5 / mPs.particles[j].density) * dotDvToRad * wGrad / denom;
-								pressureForce += mPs.particles[j].density * (mPs.particles[i].pressDivDens2 + mPs.particles[j].pressDivDens2) * wGrad;
+								const SphPair3d &pair = stream.pairs[e];
+								int j = pair.j;
+								glm::vec3 radiusIj = positionI - p.position(j);
+								float dotDvToRad = glm::dot(velocityI - p.velocity(j), radiusIj);
+								float denom = pair.distance * pair.distance + params.denomEps;
+								glm::vec3 wGrad = pair.gradFactor * radiusIj;
+								glm::vec3 viscosity = params.viscosityFactor * dotDvToRad * wGrad / denom;
+								glm::vec3 pressure = params.pressureFactor * (pressDivDens2I + p.pressDivDens2[j]) * wGrad;
+								accI += viscosity / p.density[j] - pressure * p.density[j];
+								glm::vec3 accJ = viscosity / densityI - pressure * densityI;
+								accX[j] -= accJ.x;
+								accY[j] -= accJ.y;
+								accZ[j] -= accJ.z;
 							}
+							accX[i] += accI.x;
+							accY[i] += accI.y;
+							accZ[i] += accI.z;
 						}
 					}
 				}
-				// std::cout << viscosityForce.x << " " << viscosityForce.y << " " << viscosityForce.z << std::endl;
-				mPs.particles[i].accleration += viscosityForce * constFactor;
-				// std::cout << mPs.mParticleInfos[i].accleration.z << std::endl;
-				mPs.particles[i].accleration -= pressureForce * mPs.mVolume;
+				else
+				{
+#pragma omp for schedule(static, PARTICLE_CHUNK)
+					for (int i = 0; i < particleNum; i++)
+					{
+						glm::vec3 accI = glm::vec3(0.0f);
+						bool sleepingI = sleeping && sleeping[i];
+						if (sleeping && sleeping[i] == 2 && !useList)
+						{
+							continue;
+						}
+						if (useList)
+						{
+							// the distances and kernel gradients were stored by computeDensityAndPress,
+							// or by DFSPH3d::computeDensityAndFactor in a DFSPH step
+							glm::vec3 positionI = p.position(i);
+							glm::vec3 velocityI = p.velocity(i);
+							float densityI = p.density[i];
+							float pressDivDens2I = p.pressDivDens2[i];
+							for (int e = list.offsets[i]; e < list.offsets[i + 1]; e++)
+							{
+								int j = list.indices[e];
+								float diatanceIj = list.distance[e];
+								if (j > i && diatanceIj <= Lagrangian3dPara::supportRadius && !(sleepingI && sleeping[j]))
+								{
+									glm::vec3 radiusIj = positionI - p.position(j);
+									float dotDvToRad = glm::dot(velocityI - p.velocity(j), radiusIj);
+									float denom = diatanceIj * diatanceIj + params.denomEps;
+									glm::vec3 wGrad = list.kernel[e].g * radiusIj;
+									glm::vec3 viscosity = params.viscosityFactor * dotDvToRad * wGrad / denom;
+									glm::vec3 pressure = params.pressureFactor * (pressDivDens2I + p.pressDivDens2[j]) * wGrad;
+									accI += viscosity / p.density[j] - pressure * p.density[j];
+									glm::vec3 accJ = viscosity / densityI - pressure * densityI;
+									accX[j] -= accJ.x;
+									accY[j] -= accJ.y;
+									accZ[j] -= accJ.z;
+								}
+							}
+						}
+						else
+						{
+							// the candidates of a block are contiguous, the kernels take them 8 or 16 at a time
+							int32_t neighborBlocks[ParticleSystem3d::NEIGHBOR_BLOCK_NUM];
+							mPs.getNeighborBlocks(mPs.getCell(p.position(i)), neighborBlocks);
+							for (int k = 0; k < ParticleSystem3d::NEIGHBOR_BLOCK_NUM; k++)
+							{
+								int bIdj = neighborBlocks[k];
+								if (bIdj < 0 || mPs.mBlockExtens[bIdj].y <= i + 1 || (sleepingI && blockSleeping[bIdj]))
+								{
+									continue;
+								}
+								int begin = max((int)mPs.mBlockExtens[bIdj].x, i + 1);
+								accI += mKernels.acceleration(params, p, i, begin, mPs.mBlockExtens[bIdj].y, accX, accY, accZ);
+							}
+						}
+						accX[i] += accI.x;
+						accY[i] += accI.y;
+						accZ[i] += accI.z;
+					}
+				}
+			}
+
+			glm::vec3 gravity = glm::vec3(-Lagrangian3dPara::gravityX, -Lagrangian3dPara::gravityY, -Lagrangian3dPara::gravityZ);
+#pragma omp parallel for num_threads(threadNum)
+			for (int i = 0; i < particleNum; i++)
+			{
+				if (sleeping && sleeping[i])
+				{
+					p.accX[i] = p.accY[i] = p.accZ[i] = 0.0f;
+					continue;
+				}
+				glm::vec3 accleration = gravity;
+				for (int t = 0; t < usedThreads; t++)
+				{
+					const float *acc = mThreadAcc[t].data();
+					accleration += glm::vec3(acc[i], acc[particleNum + i], acc[2 * particleNum + i]);
+				}
+				p.accX[i] = accleration.x;
+				p.accY[i] = accleration.y;
+				p.accZ[i] = accleration.z;
 			}
 		}
 
 		void Solver::eulerIntegration()
 		{
-			for (int i = 0; i < mPs.particles.size(); i++)
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
 			{
-				mPs.particles[i].velocity = mPs.particles[i].velocity + Lagrangian3dPara::dt * mPs.particles[i].accleration;
+				glm::vec3 accleration = glm::vec3(p.accX[i], p.accY[i], p.accZ[i]);
+				glm::vec3 velocity = p.velocity(i) + mDt * accleration;
 				glm::vec3 newVelocity;
 				for (int j = 0; j < 3; j++)
 				{
-					newVelocity[j] = max(-Lagrangian3dPara::maxVelocity, min(mPs.particles[i].velocity[j], Lagrangian3dPara::maxVelocity));
+					newVelocity[j] = max(-Lagrangian3dPara::maxVelocity, min(velocity[j], Lagrangian3dPara::maxVelocity));
 				}
-				mPs.particles[i].velocity = newVelocity;
-				mPs.particles[i].position = mPs.particles[i].position + Lagrangian3dPara::dt * mPs.particles[i].velocity;
+				p.setVelocity(i, newVelocity);
+				p.setPosition(i, p.position(i) + mDt * newVelocity);
 			}
 		}
 
-		void Solver::boundaryCondition()
+		void Solver::integrateVelocity()
 		{
-			for (int i = 0; i < mPs.particles.size(); i++)
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
 			{
+				glm::vec3 velocity = p.velocity(i) + mDt * glm::vec3(p.accX[i], p.accY[i], p.accZ[i]);
+				p.setVelocity(i, glm::clamp(velocity, -Lagrangian3dPara::maxVelocity, Lagrangian3dPara::maxVelocity));
+			}
+		}
 
-				bool invFlag = false;
-
-				if (mPs.particles[i].position.x < mPs.mLowerBound.x + Lagrangian3dPara::supportRadius)
-				{
-					mPs.particles[i].velocity.x = abs(mPs.particles[i].velocity.x);
-					invFlag = true;
-				}
-
-				if (mPs.particles[i].position.y < mPs.mLowerBound.y + Lagrangian3dPara::supportRadius)
-				{
-					mPs.particles[i].velocity.y = abs(mPs.particles[i].velocity.y);
-					invFlag = true;
-				}
-
-				if (mPs.particles[i].position.z < mPs.mLowerBound.z + Lagrangian3dPara::supportRadius)
-				{
-					mPs.particles[i].velocity.z = abs(mPs.particles[i].velocity.z);
-					invFlag = true;
-				}
+		void Solver::integratePosition()
+		{
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
+			{
+				glm::vec3 velocity = glm::clamp(p.velocity(i), -Lagrangian3dPara::maxVelocity, Lagrangian3dPara::maxVelocity);
+				p.setVelocity(i, velocity);
+				p.setPosition(i, p.position(i) + mDt * velocity);
+			}
+		}
 
-				if (mPs.particles[i].position.x > mPs.mUpperBound.x - Lagrangian3dPara::supportRadius)
-				{
-					mPs.particles[i].velocity.x = -abs(mPs.particles[i].velocity.x);
-					invFlag = true;
-				}
+		void Solver::boundaryCondition()
+		{
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
+			{
+				glm::vec3 position = p.position(i);
+				glm::vec3 velocity = p.velocity(i);
+				bool invFlag = false;
 
-				if (mPs.particles[i].position.y > mPs.mUpperBound.y - Lagrangian3dPara::supportRadius)
+				for (int j = 0; j < 3; j++)
 				{
-					mPs.particles[i].velocity.y = -abs(mPs.particles[i].velocity.y);
-					invFlag = true;
+					if (position[j] < mPs.mLowerBound[j] + Lagrangian3dPara::supportRadius)
+					{
+						velocity[j] = abs(velocity[j]);
+						invFlag = true;
+					}
 				}
 
-				if (mPs.particles[i].position.z > mPs.mUpperBound.z - Lagrangian3dPara::supportRadius)
+				for (int j = 0; j < 3; j++)
 				{
-					mPs.particles[i].velocity.z = -abs(mPs.particles[i].velocity.z);
-					invFlag = true;
+					if (position[j] > mPs.mUpperBound[j] - Lagrangian3dPara::supportRadius)
+					{
+						velocity[j] = -abs(velocity[j]);
+						invFlag = true;
+					}
 				}
 
 				if (invFlag)
 				{
-					mPs.particles[i].velocity *= Lagrangian3dPara::velocityAttenuation;
+					velocity *= Lagrangian3dPara::velocityAttenuation;
 				}
 
 				glm::vec3 newPosition, newVelocity;
 				for (int j = 0; j < 3; j++)
 				{
-					newPosition[j] = max((mPs.mLowerBound[j] + Lagrangian3dPara::supportRadius + Lagrangian3dPara::eps), min(mPs.particles[i].position[j], (mPs.mUpperBound[j] - (Lagrangian3dPara::supportRadius + Lagrangian3dPara::eps))));
-					newVelocity[j] = max(-Lagrangian3dPara::maxVelocity, min(mPs.particles[i].velocity[j], Lagrangian3dPara::maxVelocity));
+					newPosition[j] = max((mPs.mLowerBound[j] + Lagrangian3dPara::supportRadius + Lagrangian3dPara::eps), min(position[j], (mPs.mUpperBound[j] - (Lagrangian3dPara::supportRadius + Lagrangian3dPara::eps))));
+					newVelocity[j] = max(-Lagrangian3dPara::maxVelocity, min(velocity[j], Lagrangian3dPara::maxVelocity));
 				}
-				mPs.particles[i].position = newPosition;
-				mPs.particles[i].velocity = newVelocity;
+				p.setPosition(i, newPosition);
+				p.setVelocity(i, newVelocity);
 			}
 		}
 
 		void Solver::calculateBlockId()
 		{
-			for (int i = 0; i < mPs.particles.size(); i++)
+			ParticleArrays3d &p = mPs.mParticles;
+			int particleNum = p.size();
+#pragma omp parallel for num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
 			{
-				glm::vec3 deltePos = mPs.particles[i].position - mPs.mLowerBound;
-				glm::vec3 blockPosition = glm::floor(deltePos / mPs.mBlockSize);
-				mPs.particles[i].blockId = blockPosition.z * mPs.mBlockNum.x * mPs.mBlockNum.y + blockPosition.y * mPs.mBlockNum.x + blockPosition.x;
+				p.blockId[i] = mPs.getCellBlock(mPs.getCell(p.position(i)));
 			}
 		}
 
 		void Solver::computeDensityAndPress()
 		{
-			for (int i = 0; i < mPs.particles.size(); i++)
+			// each particle gathers from its neighbours and only writes itself
+			ParticleArrays3d &p = mPs.mParticles;
+			NeighborList3d &list = mPs.mNeighborList;
+			bool useList = mPs.useNeighborList();
+			if (!useList && Lagrangian3dPara::pairStream)
 			{
-				for (int k = 0; k < mPs.mBlockIdOffs.size(); k++)
-				{ // for all neighbor block
-					int bIdj = mPs.particles[i].blockId + mPs.mBlockIdOffs[k];
-					if (bIdj >= 0 && bIdj < mPs.mBlockExtens.size())
+				recordPairStreams();
+				return;
+			}
+
+			// sleeping particles keep the density and pressure they had when they fell asleep.
+			// With neighbour lists they still refresh the pairs with awake neighbours, which
+			// computeAccleration evaluates from their side
+			const uint8_t *sleeping = mPs.mSleeping.empty() ? NULL : mPs.mSleeping.data();
+			SphPairParams params = pairParams();
+			int particleNum = p.size();
+#pragma omp parallel for schedule(dynamic, PARTICLE_CHUNK) num_threads(numThreads())
+			for (int i = 0; i < particleNum; i++)
+			{
+				bool sleepingI = sleeping && sleeping[i];
+				if (sleepingI && !useList)
+				{
+					continue;
+				}
+				float density = 0.0f;
+				if (useList)
+				{
+					glm::vec3 positionI = p.position(i);
+					// one distance and kernel evaluation per pair and substep, shared with computeAccleration
+					for (int e = list.offsets[i]; e < list.offsets[i + 1]; e++)
 					{
-						for (int j = mPs.mBlockExtens[bIdj].x; j < mPs.mBlockExtens[bIdj].y; j++)
+						if (sleepingI && sleeping[list.indices[e]])
+						{
+							continue;
+						}
+						glm::vec3 radiusIj = positionI - p.position(list.indices[e]);
+						float diatanceIj = length(radiusIj);
+						glm::vec2 kernel = glm::vec2(0.0f);
+						if (diatanceIj <= Lagrangian3dPara::supportRadius)
+						{
+							// d = h would index one past the kernel table, clamp to its last slot as kernelSlot() does
+							kernel = mW.GetGrad(min(diatanceIj / Lagrangian3dPara::supportRadius, 0.999f));
+							density += kernel.r;
+						}
+						list.distance[e] = diatanceIj;
+						list.kernel[e] = kernel;
+					}
+				}
+				else
+				{
+					int32_t neighborBlocks[ParticleSystem3d::NEIGHBOR_BLOCK_NUM];
+					mPs.getNeighborBlocks(mPs.getCell(p.position(i)), neighborBlocks);
+					for (int k = 0; k < ParticleSystem3d::NEIGHBOR_BLOCK_NUM; k++)
+					{ // for all neighbor block
+						int bIdj = neighborBlocks[k];
+						if (bIdj >= 0)
 						{ // for all neighbor particles
-							glm::vec3 radiusIj = mPs.particles[i].position - mPs.particles[j].position;
-							float diatanceIj = length(radiusIj);
-							if (diatanceIj <= Lagrangian3dPara::supportRadius)
-							{
-								mPs.particles[i].density += mW.GetGrad(diatanceIj / Lagrangian3dPara::supportRadius).r;
-							}
+							density += mKernels.density(params, p, i, mPs.mBlockExtens[bIdj].x, mPs.mBlockExtens[bIdj].y);
 						}
 					}
 				}
 
-				mPs.particles[i].density *= (mPs.mVolume * Lagrangian3dPara::density);
-				mPs.particles[i].density = max(mPs.particles[i].density, Lagrangian3dPara::density);
-				mPs.particles[i].pressure = Lagrangian3dPara::stiffness * (pow(mPs.particles[i].density / Lagrangian3dPara::density, Lagrangian3dPara::exponent) - 1.0);
-				mPs.particles[i].pressDivDens2 = mPs.particles[i].pressure / pow(mPs.particles[i].density, 2);
+				if (sleepingI)
+				{
+					continue;
+				}
+				density *= (mPs.mVolume * Lagrangian3dPara::density);
+				p.density[i] = max(density, Lagrangian3dPara::density);
+				p.pressure[i] = Lagrangian3dPara::stiffness * (pow(p.density[i] / Lagrangian3dPara::density, Lagrangian3dPara::exponent) - 1.0);
+				p.pressDivDens2[i] = p.pressure[i] / pow(p.density[i], 2);
+			}
+		}
+
+		void Solver::recordPairStreams()
+		{
+			// the density walk of the grid, recording the pairs j > i on the way. The
+			// streams follow the particle order, which follows the blocks, so a thread's
+			// range is a compact region of space. A sleeping particle only walks the awake
+			// blocks, for the pairs computeAccleration needs, and keeps its density
+			ParticleArrays3d &p = mPs.mParticles;
+			const uint8_t *sleeping = mPs.mSleeping.empty() ? NULL : mPs.mSleeping.data();
+			const uint8_t *blockSleeping = sleeping ? mPs.mBlockSleeping.data() : NULL;
+			SphPairParams params = pairParams();
+			int particleNum = p.size();
+#pragma omp parallel num_threads(numThreads())
+			{
+#pragma omp single
+				mPairStreams.resize(omp_get_num_threads());
+
+				PairStream3d &stream = mPairStreams[omp_get_thread_num()];
+				stream.begin = (long long)particleNum * omp_get_thread_num() / omp_get_num_threads();
+				stream.end = (long long)particleNum * (omp_get_thread_num() + 1) / omp_get_num_threads();
+				stream.offsets.resize(stream.end - stream.begin + 1);
+				stream.offsets[0] = 0;
+				int count = 0;
+				for (int i = stream.begin; i < stream.end; i++)
+				{
+					float density = 0.0f;
+					bool sleepingI = sleeping && sleeping[i];
+					if (sleeping && sleeping[i] == 2)
+					{
+						stream.offsets[i - stream.begin + 1] = count;
+						continue;
+					}
+					int32_t neighborBlocks[ParticleSystem3d::NEIGHBOR_BLOCK_NUM];
+					mPs.getNeighborBlocks(mPs.getCell(p.position(i)), neighborBlocks);
+					for (int k = 0; k < ParticleSystem3d::NEIGHBOR_BLOCK_NUM; k++)
+					{
+						int bIdj = neighborBlocks[k];
+						if (bIdj < 0 || (sleepingI && blockSleeping[bIdj]))
+						{
+							continue;
+						}
+						int begin = mPs.mBlockExtens[bIdj].x;
+						int end = mPs.mBlockExtens[bIdj].y;
+						if (count + end - begin > stream.pairs.size())
+						{
+							stream.pairs.resize(2 * (count + end - begin));
+						}
+						density += mKernels.densityAndPairs(params, p, i, begin, end, stream.pairs.data(), count);
+					}
+					stream.offsets[i - stream.begin + 1] = count;
+					if (sleepingI)
+					{
+						continue;
+					}
+
+					density *= (mPs.mVolume * Lagrangian3dPara::density);
+					p.density[i] = max(density, Lagrangian3dPara::density);
+					p.pressure[i] = Lagrangian3dPara::stiffness * (pow(p.density[i] / Lagrangian3dPara::density, Lagrangian3dPara::exponent) - 1.0);
+					p.pressDivDens2[i] = p.pressure[i] / pow(p.density[i], 2);
+				}
 			}
+			mPairStreamsRecorded = true;
 		}
 	}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,385 @@
+#include "fluid3d/Lagrangian/include/SphKernels3d.h"
+#include "CpuFeatures.h"
+#include <immintrin.h>
+
+namespace FluidSimulation
+{
+
+	namespace Lagrangian3d
+	{
+		// table slot of a distance, as WCubicSpline3d::GetGrad. d = h lands one past the
+		// last slot and is clamped
+		static inline int kernelSlot(const SphPairParams &params, float distance)
+		{
+			int slot = (int)(distance / params.supportRadius * params.kernelTableSize);
+			return slot < params.kernelTableSize - 1 ? slot : params.kernelTableSize - 1;
+		}
+
+		static float densityScalar(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end)
+		{
+			glm::vec3 positionI = p.position(i);
+			float density = 0.0f;
+			for (int j = begin; j < end; j++)
+			{
+				float diatanceIj = glm::length(positionI - p.position(j));
+				if (diatanceIj <= params.supportRadius)
+				{
+					density += params.kernelTable[2 * kernelSlot(params, diatanceIj)];
+				}
+			}
+			return density;
+		}
+
+		static float densityAndPairsScalar(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+										   SphPair3d *pairs, int &count)
+		{
+			glm::vec3 positionI = p.position(i);
+			float density = 0.0f;
+			for (int j = begin; j < end; j++)
+			{
+				float diatanceIj = glm::length(positionI - p.position(j));
+				if (diatanceIj <= params.supportRadius)
+				{
+					const float *kernel = &params.kernelTable[2 * kernelSlot(params, diatanceIj)];
+					density += kernel[0];
+					if (j > i)
+					{
+						SphPair3d pair = {(uint32_t)j, diatanceIj, kernel[1]};
+						pairs[count++] = pair;
+					}
+				}
+			}
+			return density;
+		}
+
+		static glm::vec3 accelerationScalar(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+											float *accX, float *accY, float *accZ)
+		{
+			glm::vec3 positionI = p.position(i);
+			glm::vec3 velocityI = p.velocity(i);
+			float densityI = p.density[i];
+			float pressDivDens2I = p.pressDivDens2[i];
+			glm::vec3 accI = glm::vec3(0.0f);
+			for (int j = begin; j < end; j++)
+			{
+				glm::vec3 radiusIj = positionI - p.position(j);
+				float diatanceIj = glm::length(radiusIj);
+				if (diatanceIj <= params.supportRadius)
+				{
+					float dotDvToRad = glm::dot(velocityI - p.velocity(j), radiusIj);
+					float denom = diatanceIj * diatanceIj + params.denomEps;
+					glm::vec3 wGrad = params.kernelTable[2 * kernelSlot(params, diatanceIj) + 1] * radiusIj;
+					glm::vec3 viscosity = params.viscosityFactor * dotDvToRad * wGrad / denom;
+					glm::vec3 pressure = params.pressureFactor * (pressDivDens2I + p.pressDivDens2[j]) * wGrad;
+					accI += viscosity / p.density[j] - pressure * p.density[j];
+					glm::vec3 accJ = viscosity / densityI - pressure * densityI;
+					accX[j] -= accJ.x;
+					accY[j] -= accJ.y;
+					accZ[j] -= accJ.z;
+				}
+			}
+			return accI;
+		}
+
+		// ---------------------------------------------------------------- AVX2, 8 lanes
+
+		GLB_TARGET_AVX2 static inline float sum8(__m256 v)
+		{
+			__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+			s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+			s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+			return _mm_cvtss_f32(s);
+		}
+
+		// distances of 8 candidates, the slots of their kernel values and the lanes inside the support radius
+		GLB_TARGET_AVX2 static inline __m256 distance8(const SphPairParams &params, __m256 rx, __m256 ry, __m256 rz,
+													   __m256i &slot, __m256 &inside)
+		{
+			__m256 h = _mm256_set1_ps(params.supportRadius);
+			__m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry)), _mm256_mul_ps(rz, rz)));
+			__m256 f = _mm256_mul_ps(_mm256_div_ps(d, h), _mm256_set1_ps((float)params.kernelTableSize));
+			slot = _mm256_min_epi32(_mm256_cvttps_epi32(f), _mm256_set1_epi32(params.kernelTableSize - 1));
+			inside = _mm256_cmp_ps(d, h, _CMP_LE_OQ);
+			return d;
+		}
+
+		// lanes of the candidates j, j + 1, ... still before end, as the sign bits of 8 ints
+		GLB_TARGET_AVX2 static inline __m256i lanes8(int j, int end)
+		{
+			return _mm256_cmpgt_epi32(_mm256_set1_epi32(end - j), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		}
+
+		GLB_TARGET_AVX2 static float densityAVX2(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end)
+		{
+			__m256 xi = _mm256_set1_ps(p.posX[i]);
+			__m256 yi = _mm256_set1_ps(p.posY[i]);
+			__m256 zi = _mm256_set1_ps(p.posZ[i]);
+			__m256 density = _mm256_setzero_ps();
+			for (int j = begin; j < end; j += 8)
+			{
+				// the last candidates of the block load with a partial mask
+				__m256i lanes = lanes8(j, end);
+				__m256 rx = _mm256_sub_ps(xi, _mm256_maskload_ps(&p.posX[j], lanes));
+				__m256 ry = _mm256_sub_ps(yi, _mm256_maskload_ps(&p.posY[j], lanes));
+				__m256 rz = _mm256_sub_ps(zi, _mm256_maskload_ps(&p.posZ[j], lanes));
+				__m256i slot;
+				__m256 inside;
+				distance8(params, rx, ry, rz, slot, inside);
+				inside = _mm256_and_ps(inside, _mm256_castsi256_ps(lanes));
+				__m256 w = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), params.kernelTable, _mm256_slli_epi32(slot, 1), inside, 4);
+				density = _mm256_add_ps(density, w);
+			}
+			return sum8(density);
+		}
+
+		GLB_TARGET_AVX2 static float densityAndPairsAVX2(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+														 SphPair3d *pairs, int &count)
+		{
+			__m256 xi = _mm256_set1_ps(p.posX[i]);
+			__m256 yi = _mm256_set1_ps(p.posY[i]);
+			__m256 zi = _mm256_set1_ps(p.posZ[i]);
+			__m256 density = _mm256_setzero_ps();
+			alignas(32) float distance[8];
+			alignas(32) float gradFactor[8];
+			for (int j = begin; j < end; j += 8)
+			{
+				__m256i lanes = lanes8(j, end);
+				__m256 rx = _mm256_sub_ps(xi, _mm256_maskload_ps(&p.posX[j], lanes));
+				__m256 ry = _mm256_sub_ps(yi, _mm256_maskload_ps(&p.posY[j], lanes));
+				__m256 rz = _mm256_sub_ps(zi, _mm256_maskload_ps(&p.posZ[j], lanes));
+				__m256i slot;
+				__m256 inside;
+				__m256 d = distance8(params, rx, ry, rz, slot, inside);
+				inside = _mm256_and_ps(inside, _mm256_castsi256_ps(lanes));
+				__m256i index = _mm256_slli_epi32(slot, 1);
+				density = _mm256_add_ps(density, _mm256_mask_i32gather_ps(_mm256_setzero_ps(), params.kernelTable, index, inside, 4));
+
+				// the lanes inside the radius are written out one by one, most blocks hold few of them
+				int bits = _mm256_movemask_ps(inside);
+				if (j + 7 <= i || bits == 0)
+				{
+					continue;
+				}
+				_mm256_store_ps(distance, d);
+				_mm256_store_ps(gradFactor, _mm256_mask_i32gather_ps(_mm256_setzero_ps(), params.kernelTable + 1, index, inside, 4));
+				for (int k = 0; k < 8; k++)
+				{
+					if ((bits >> k & 1) && j + k > i)
+					{
+						SphPair3d pair = {(uint32_t)(j + k), distance[k], gradFactor[k]};
+						pairs[count++] = pair;
+					}
+				}
+			}
+			return sum8(density);
+		}
+
+		GLB_TARGET_AVX2 static glm::vec3 accelerationAVX2(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+														  float *accX, float *accY, float *accZ)
+		{
+			__m256 xi = _mm256_set1_ps(p.posX[i]);
+			__m256 yi = _mm256_set1_ps(p.posY[i]);
+			__m256 zi = _mm256_set1_ps(p.posZ[i]);
+			__m256 vxi = _mm256_set1_ps(p.velX[i]);
+			__m256 vyi = _mm256_set1_ps(p.velY[i]);
+			__m256 vzi = _mm256_set1_ps(p.velZ[i]);
+			__m256 densityI = _mm256_set1_ps(p.density[i]);
+			__m256 pressDivDens2I = _mm256_set1_ps(p.pressDivDens2[i]);
+			__m256 viscosityFactor = _mm256_set1_ps(params.viscosityFactor);
+			__m256 pressureFactor = _mm256_set1_ps(params.pressureFactor);
+			__m256 denomEps = _mm256_set1_ps(params.denomEps);
+			__m256 one = _mm256_set1_ps(1.0f);
+			__m256 accIX = _mm256_setzero_ps(), accIY = _mm256_setzero_ps(), accIZ = _mm256_setzero_ps();
+			for (int j = begin; j < end; j += 8)
+			{
+				__m256i lanes = lanes8(j, end);
+				__m256 rx = _mm256_sub_ps(xi, _mm256_maskload_ps(&p.posX[j], lanes));
+				__m256 ry = _mm256_sub_ps(yi, _mm256_maskload_ps(&p.posY[j], lanes));
+				__m256 rz = _mm256_sub_ps(zi, _mm256_maskload_ps(&p.posZ[j], lanes));
+				__m256i slot;
+				__m256 inside;
+				__m256 d = distance8(params, rx, ry, rz, slot, inside);
+				inside = _mm256_and_ps(inside, _mm256_castsi256_ps(lanes));
+				// lanes outside the radius get a zero gradient and add nothing
+				__m256 gradFactor = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), params.kernelTable + 1, _mm256_slli_epi32(slot, 1), inside, 4);
+
+				__m256 dvx = _mm256_sub_ps(vxi, _mm256_maskload_ps(&p.velX[j], lanes));
+				__m256 dvy = _mm256_sub_ps(vyi, _mm256_maskload_ps(&p.velY[j], lanes));
+				__m256 dvz = _mm256_sub_ps(vzi, _mm256_maskload_ps(&p.velZ[j], lanes));
+				__m256 dotDvToRad = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dvx, rx), _mm256_mul_ps(dvy, ry)), _mm256_mul_ps(dvz, rz));
+				__m256 denom = _mm256_add_ps(_mm256_mul_ps(d, d), denomEps);
+				__m256 viscosity = _mm256_div_ps(_mm256_mul_ps(viscosityFactor, dotDvToRad), denom);
+				// lanes past the block read a density of one so the division stays finite
+				__m256 densityJ = _mm256_blendv_ps(one, _mm256_maskload_ps(&p.density[j], lanes), _mm256_castsi256_ps(lanes));
+				__m256 pressure = _mm256_mul_ps(pressureFactor, _mm256_add_ps(pressDivDens2I, _mm256_maskload_ps(&p.pressDivDens2[j], lanes)));
+
+				// both sides are (viscosity / rho - pressure * rho) * wGrad, with rho of the other particle
+				__m256 factorI = _mm256_mul_ps(_mm256_sub_ps(_mm256_div_ps(viscosity, densityJ), _mm256_mul_ps(pressure, densityJ)), gradFactor);
+				__m256 factorJ = _mm256_mul_ps(_mm256_sub_ps(_mm256_div_ps(viscosity, densityI), _mm256_mul_ps(pressure, densityI)), gradFactor);
+				accIX = _mm256_add_ps(accIX, _mm256_mul_ps(factorI, rx));
+				accIY = _mm256_add_ps(accIY, _mm256_mul_ps(factorI, ry));
+				accIZ = _mm256_add_ps(accIZ, _mm256_mul_ps(factorI, rz));
+				_mm256_maskstore_ps(&accX[j], lanes, _mm256_sub_ps(_mm256_maskload_ps(&accX[j], lanes), _mm256_mul_ps(factorJ, rx)));
+				_mm256_maskstore_ps(&accY[j], lanes, _mm256_sub_ps(_mm256_maskload_ps(&accY[j], lanes), _mm256_mul_ps(factorJ, ry)));
+				_mm256_maskstore_ps(&accZ[j], lanes, _mm256_sub_ps(_mm256_maskload_ps(&accZ[j], lanes), _mm256_mul_ps(factorJ, rz)));
+			}
+			return glm::vec3(sum8(accIX), sum8(accIY), sum8(accIZ));
+		}
+
+		// ------------------------------------------------------------- AVX-512, 16 lanes
+
+		GLB_TARGET_AVX512 static inline __m512 distance16(const SphPairParams &params, __m512 rx, __m512 ry, __m512 rz,
+														  __m512i &slot, __mmask16 &inside)
+		{
+			__m512 h = _mm512_set1_ps(params.supportRadius);
+			__m512 d = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(rx, rx), _mm512_mul_ps(ry, ry)), _mm512_mul_ps(rz, rz)));
+			__m512 f = _mm512_mul_ps(_mm512_div_ps(d, h), _mm512_set1_ps((float)params.kernelTableSize));
+			slot = _mm512_min_epi32(_mm512_cvttps_epi32(f), _mm512_set1_epi32(params.kernelTableSize - 1));
+			inside = _mm512_cmp_ps_mask(d, h, _CMP_LE_OQ);
+			return d;
+		}
+
+		GLB_TARGET_AVX512 static float densityAVX512(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end)
+		{
+			__m512 xi = _mm512_set1_ps(p.posX[i]);
+			__m512 yi = _mm512_set1_ps(p.posY[i]);
+			__m512 zi = _mm512_set1_ps(p.posZ[i]);
+			__m512 density = _mm512_setzero_ps();
+			int j = begin;
+			for (; j < end; j += 16)
+			{
+				// the last candidates of the block load with a partial mask
+				__mmask16 lanes = end - j >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (end - j)) - 1);
+				__m512 rx = _mm512_sub_ps(xi, _mm512_maskz_loadu_ps(lanes, &p.posX[j]));
+				__m512 ry = _mm512_sub_ps(yi, _mm512_maskz_loadu_ps(lanes, &p.posY[j]));
+				__m512 rz = _mm512_sub_ps(zi, _mm512_maskz_loadu_ps(lanes, &p.posZ[j]));
+				__m512i slot;
+				__mmask16 inside;
+				distance16(params, rx, ry, rz, slot, inside);
+				inside &= lanes;
+				__m512 w = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, _mm512_slli_epi32(slot, 1), params.kernelTable, 4);
+				density = _mm512_add_ps(density, w);
+			}
+			return _mm512_reduce_add_ps(density);
+		}
+
+		GLB_TARGET_AVX512 static float densityAndPairsAVX512(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+															 SphPair3d *pairs, int &count)
+		{
+			__m512 xi = _mm512_set1_ps(p.posX[i]);
+			__m512 yi = _mm512_set1_ps(p.posY[i]);
+			__m512 zi = _mm512_set1_ps(p.posZ[i]);
+			__m512 density = _mm512_setzero_ps();
+			alignas(64) float distance[16];
+			alignas(64) float gradFactor[16];
+			for (int j = begin; j < end; j += 16)
+			{
+				__mmask16 lanes = end - j >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (end - j)) - 1);
+				__m512 rx = _mm512_sub_ps(xi, _mm512_maskz_loadu_ps(lanes, &p.posX[j]));
+				__m512 ry = _mm512_sub_ps(yi, _mm512_maskz_loadu_ps(lanes, &p.posY[j]));
+				__m512 rz = _mm512_sub_ps(zi, _mm512_maskz_loadu_ps(lanes, &p.posZ[j]));
+				__m512i slot;
+				__mmask16 inside;
+				__m512 d = distance16(params, rx, ry, rz, slot, inside);
+				inside &= lanes;
+				__m512i index = _mm512_slli_epi32(slot, 1);
+				density = _mm512_add_ps(density, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, index, params.kernelTable, 4));
+
+				int bits = inside;
+				if (j + 15 <= i || bits == 0)
+				{
+					continue;
+				}
+				_mm512_store_ps(distance, d);
+				_mm512_store_ps(gradFactor, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, index, params.kernelTable + 1, 4));
+				for (int k = 0; k < 16; k++)
+				{
+					if ((bits >> k & 1) && j + k > i)
+					{
+						SphPair3d pair = {(uint32_t)(j + k), distance[k], gradFactor[k]};
+						pairs[count++] = pair;
+					}
+				}
+			}
+			return _mm512_reduce_add_ps(density);
+		}
+
+		GLB_TARGET_AVX512 static glm::vec3 accelerationAVX512(const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end,
+															  float *accX, float *accY, float *accZ)
+		{
+			__m512 xi = _mm512_set1_ps(p.posX[i]);
+			__m512 yi = _mm512_set1_ps(p.posY[i]);
+			__m512 zi = _mm512_set1_ps(p.posZ[i]);
+			__m512 vxi = _mm512_set1_ps(p.velX[i]);
+			__m512 vyi = _mm512_set1_ps(p.velY[i]);
+			__m512 vzi = _mm512_set1_ps(p.velZ[i]);
+			__m512 densityI = _mm512_set1_ps(p.density[i]);
+			__m512 pressDivDens2I = _mm512_set1_ps(p.pressDivDens2[i]);
+			__m512 viscosityFactor = _mm512_set1_ps(params.viscosityFactor);
+			__m512 pressureFactor = _mm512_set1_ps(params.pressureFactor);
+			__m512 denomEps = _mm512_set1_ps(params.denomEps);
+			__m512 one = _mm512_set1_ps(1.0f);
+			__m512 accIX = _mm512_setzero_ps(), accIY = _mm512_setzero_ps(), accIZ = _mm512_setzero_ps();
+			for (int j = begin; j < end; j += 16)
+			{
+				__mmask16 lanes = end - j >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (end - j)) - 1);
+				__m512 rx = _mm512_sub_ps(xi, _mm512_maskz_loadu_ps(lanes, &p.posX[j]));
+				__m512 ry = _mm512_sub_ps(yi, _mm512_maskz_loadu_ps(lanes, &p.posY[j]));
+				__m512 rz = _mm512_sub_ps(zi, _mm512_maskz_loadu_ps(lanes, &p.posZ[j]));
+				__m512i slot;
+				__mmask16 inside;
+				__m512 d = distance16(params, rx, ry, rz, slot, inside);
+				inside &= lanes;
+				// lanes outside the radius get a zero gradient and add nothing
+				__m512 gradFactor = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, _mm512_slli_epi32(slot, 1), params.kernelTable + 1, 4);
+
+				__m512 dvx = _mm512_sub_ps(vxi, _mm512_maskz_loadu_ps(lanes, &p.velX[j]));
+				__m512 dvy = _mm512_sub_ps(vyi, _mm512_maskz_loadu_ps(lanes, &p.velY[j]));
+				__m512 dvz = _mm512_sub_ps(vzi, _mm512_maskz_loadu_ps(lanes, &p.velZ[j]));
+				__m512 dotDvToRad = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dvx, rx), _mm512_mul_ps(dvy, ry)), _mm512_mul_ps(dvz, rz));
+				__m512 denom = _mm512_add_ps(_mm512_mul_ps(d, d), denomEps);
+				__m512 viscosity = _mm512_div_ps(_mm512_mul_ps(viscosityFactor, dotDvToRad), denom);
+				// lanes past the block read a density of one so the division stays finite
+				__m512 densityJ = _mm512_mask_loadu_ps(one, lanes, &p.density[j]);
+				__m512 pressure = _mm512_mul_ps(pressureFactor, _mm512_add_ps(pressDivDens2I, _mm512_maskz_loadu_ps(lanes, &p.pressDivDens2[j])));
+
+				__m512 factorI = _mm512_mul_ps(_mm512_sub_ps(_mm512_div_ps(viscosity, densityJ), _mm512_mul_ps(pressure, densityJ)), gradFactor);
+				__m512 factorJ = _mm512_mul_ps(_mm512_sub_ps(_mm512_div_ps(viscosity, densityI), _mm512_mul_ps(pressure, densityI)), gradFactor);
+				accIX = _mm512_add_ps(accIX, _mm512_mul_ps(factorI, rx));
+				accIY = _mm512_add_ps(accIY, _mm512_mul_ps(factorI, ry));
+				accIZ = _mm512_add_ps(accIZ, _mm512_mul_ps(factorI, rz));
+				_mm512_mask_storeu_ps(&accX[j], lanes, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, &accX[j]), _mm512_mul_ps(factorJ, rx)));
+				_mm512_mask_storeu_ps(&accY[j], lanes, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, &accY[j]), _mm512_mul_ps(factorJ, ry)));
+				_mm512_mask_storeu_ps(&accZ[j], lanes, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, &accZ[j]), _mm512_mul_ps(factorJ, rz)));
+			}
+			return glm::vec3(_mm512_reduce_add_ps(accIX), _mm512_reduce_add_ps(accIY), _mm512_reduce_add_ps(accIZ));
+		}
+
+		SphKernels3d SphKernels3d::select(int maxIsa)
+		{
+			SphKernels3d kernels;
+			if (maxIsa >= AVX512 && Glb::CpuFeatures::hasAVX512())
+			{
+				kernels.density = densityAVX512;
+				kernels.densityAndPairs = densityAndPairsAVX512;
+				kernels.acceleration = accelerationAVX512;
+				kernels.isa = AVX512;
+			}
+			else if (maxIsa >= AVX2 && Glb::CpuFeatures::hasAVX2())
+			{
+				kernels.density = densityAVX2;
+				kernels.densityAndPairs = densityAndPairsAVX2;
+				kernels.acceleration = accelerationAVX2;
+				kernels.isa = AVX2;
+			}
+			else
+			{
+				kernels.density = densityScalar;
+				kernels.densityAndPairs = densityAndPairsScalar;
+				kernels.acceleration = accelerationScalar;
+				kernels.isa = Scalar;
+			}
+			return kernels;
+		}
+	}
+}
@@ -0,0 +1,203 @@
+// Checks that the AVX2 and AVX-512 versions of SphKernels3d agree with the scalar
+// version on random blocks. Versions the CPU does not support are skipped. Returns
+// nonzero if any comparison fails
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "SphKernels3d.h"
+#include "CpuFeatures.h"
+
+using namespace FluidSimulation::Lagrangian3d;
+
+// block lengths around the 8 and 16 lane widths, so every version runs partial masks
+static const int BLOCK_LENGTHS[] = {0, 1, 7, 9, 15, 17, 23, 31, 33, 45};
+
+// relative to the largest magnitude of the compared quantity in the block, the
+// versions sum in a different order
+static const float TOLERANCE = 1e-4f;
+
+static const float H = 0.25f;
+
+static int gFailures = 0;
+
+static void check(bool ok, const char *isa, const char *what, int length, int i)
+{
+	if (!ok)
+	{
+		printf("FAILED %s %s: block length %d, particle %d\n", isa, what, length, i);
+		gFailures++;
+	}
+}
+
+static bool agree(float a, float b, float scale)
+{
+	return fabs(a - b) <= TOLERANCE * scale;
+}
+
+// particle i at the centre of a cube of side 3h, candidates j in [begin, end) spread
+// over the cube. Some sit exactly at the support radius or just beyond it on an axis,
+// where the distance is exact in float and every version must take the same side
+static void fillParticles(ParticleArrays3d &p, int i, int begin, int end, std::mt19937 &rng)
+{
+	std::uniform_real_distribution<float> offset(-1.5f * H, 1.5f * H);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> density(900.0f, 1100.0f);
+	std::uniform_real_distribution<float> pressDivDens2(0.0f, 2e-3f);
+
+	int n = p.size();
+	for (int k = 0; k < n; k++)
+	{
+		p.setVelocity(k, glm::vec3(unit(rng), unit(rng), unit(rng)));
+		p.density[k] = density(rng);
+		p.pressure[k] = 0.0f;
+		p.pressDivDens2[k] = pressDivDens2(rng);
+		p.accX[k] = unit(rng);
+		p.accY[k] = unit(rng);
+		p.accZ[k] = unit(rng);
+	}
+
+	glm::vec3 centre = glm::vec3(0.5f);
+	p.setPosition(i, centre);
+	for (int j = begin; j < end; j++)
+	{
+		if (j == i)
+		{
+			continue;
+		}
+		glm::vec3 position = centre + glm::vec3(offset(rng), offset(rng), offset(rng));
+		switch (j % 5)
+		{
+		case 1:
+			// exactly at h
+			position = centre;
+			position[j % 3] += (j & 8) ? H : -H;
+			break;
+		case 3:
+			// the next float beyond h
+			position = centre;
+			position[j % 3] = nextafterf(centre[j % 3] + H, 1.0f);
+			break;
+		}
+		p.setPosition(j, position);
+	}
+}
+
+static void compareDensity(const SphKernels3d &ref, const SphKernels3d &kernels, const char *isa,
+						   const SphPairParams &params, const ParticleArrays3d &p, int i, int begin, int end)
+{
+	int length = end - begin;
+	float expected = ref.density(params, p, i, begin, end);
+	float density = kernels.density(params, p, i, begin, end);
+	check(agree(density, expected, expected), isa, "density", length, i);
+
+	// room for the whole block, as the solver provides
+	std::vector<SphPair3d> refPairs(length + 1), pairs(length + 1);
+	int refCount = 0, count = 0;
+	float refPairDensity = ref.densityAndPairs(params, p, i, begin, end, refPairs.data(), refCount);
+	float pairDensity = kernels.densityAndPairs(params, p, i, begin, end, pairs.data(), count);
+	check(agree(pairDensity, refPairDensity, refPairDensity), isa, "densityAndPairs density", length, i);
+	check(count == refCount, isa, "densityAndPairs pair count", length, i);
+	if (count != refCount)
+	{
+		return;
+	}
+
+	// the pairs are recorded in candidate order by every version
+	float gradScale = 0.0f;
+	for (int k = 0; k < refCount; k++)
+	{
+		gradScale = max(gradScale, (float)fabs(refPairs[k].gradFactor));
+	}
+	for (int k = 0; k < refCount; k++)
+	{
+		check(pairs[k].j == refPairs[k].j && pairs[k].j > (uint32_t)i, isa, "densityAndPairs pair index", length, i);
+		check(agree(pairs[k].distance, refPairs[k].distance, H), isa, "densityAndPairs pair distance", length, i);
+		check(agree(pairs[k].gradFactor, refPairs[k].gradFactor, gradScale), isa, "densityAndPairs pair gradient", length, i);
+	}
+}
+
+// particle 0 against the block [1, n), the force pass only sees pairs with j > i
+static void compareAcceleration(const SphKernels3d &ref, const SphKernels3d &kernels, const char *isa,
+								const SphPairParams &params, const ParticleArrays3d &p, int length)
+{
+	int n = p.size();
+	std::vector<float> refX(p.accX), refY(p.accY), refZ(p.accZ);
+	std::vector<float> accX(p.accX), accY(p.accY), accZ(p.accZ);
+	glm::vec3 expected = ref.acceleration(params, p, 0, 1, n, refX.data(), refY.data(), refZ.data());
+	glm::vec3 acc = kernels.acceleration(params, p, 0, 1, n, accX.data(), accY.data(), accZ.data());
+
+	float scale = max(max(fabs(expected.x), fabs(expected.y)), fabs(expected.z));
+	for (int d = 0; d < 3; d++)
+	{
+		check(agree(acc[d], expected[d], scale), isa, "acceleration of i", length, 0);
+	}
+
+	// the share of j is scattered into the buffers, which start from random values
+	float scaleJ = 0.0f;
+	for (int j = 1; j < n; j++)
+	{
+		scaleJ = max(scaleJ, (float)fabs(refX[j] - p.accX[j]));
+		scaleJ = max(scaleJ, (float)fabs(refY[j] - p.accY[j]));
+		scaleJ = max(scaleJ, (float)fabs(refZ[j] - p.accZ[j]));
+	}
+	check(accX[0] == p.accX[0] && accY[0] == p.accY[0] && accZ[0] == p.accZ[0], isa, "acceleration outside the block", length, 0);
+	for (int j = 1; j < n; j++)
+	{
+		bool ok = agree(accX[j], refX[j], scaleJ) && agree(accY[j], refY[j], scaleJ) && agree(accZ[j], refZ[j], scaleJ);
+		check(ok, isa, "acceleration of j", length, j);
+	}
+}
+
+int main()
+{
+	Glb::WCubicSpline3d w(H);
+	SphPairParams params;
+	params.supportRadius = H;
+	params.kernelTable = w.GetData();
+	params.kernelTableSize = w.GetBufferSize();
+	params.viscosityFactor = 0.05f;
+	params.pressureFactor = 1e-5f;
+	params.denomEps = 0.01f * H * H;
+
+	SphKernels3d ref = SphKernels3d::select(SphKernels3d::Scalar);
+	const char *names[] = {"Scalar", "AVX2", "AVX-512"};
+	for (int isa = SphKernels3d::AVX2; isa <= SphKernels3d::AVX512; isa++)
+	{
+		// select() falls back to a narrower version when the CPU lacks this one
+		SphKernels3d kernels = SphKernels3d::select(isa);
+		if (kernels.isa != isa)
+		{
+			printf("%s: not supported, skipped\n", names[isa]);
+			continue;
+		}
+
+		std::mt19937 rng(1234);
+		int failures = gFailures;
+		for (int length : BLOCK_LENGTHS)
+		{
+			for (int trial = 0; trial < 20; trial++)
+			{
+				// i in front of the block, as for a neighbouring block
+				ParticleArrays3d p;
+				p.resize(length + 1);
+				fillParticles(p, 0, 1, length + 1, rng);
+				compareDensity(ref, kernels, names[isa], params, p, 0, 1, length + 1);
+				compareAcceleration(ref, kernels, names[isa], params, p, length);
+
+				// i inside the block, as for its own block, where only j > i are recorded
+				if (length > 0)
+				{
+					ParticleArrays3d q;
+					q.resize(length);
+					int i = trial % length;
+					fillParticles(q, i, 0, length, rng);
+					compareDensity(ref, kernels, names[isa], params, q, i, 0, length);
+				}
+			}
+		}
+		printf("%s: %s\n", names[isa], gFailures == failures ? "agrees with Scalar" : "FAILED");
+	}
+
+	return gFailures == 0 ? 0 : 1;
+}
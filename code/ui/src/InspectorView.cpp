@@ -100,10 +100,59 @@ namespace FluidSimulation
 				ImGui::Spacing();
 
 				ImGui::Text("Solver:");
-				ImGui::SliderFloat("Delta Time", &Lagrangian2dPara::dt, 0.0f, 0.003f, "%.5f");
+				ImGui::Checkbox("Adaptive Time Step", &Lagrangian2dPara::adaptiveTimeStep);
+				if (Lagrangian2dPara::adaptiveTimeStep)
+				{
+					ImGui::SliderFloat("Frame Time", &Lagrangian2dPara::frameTime, 0.0005f, 0.02f, "%.4f");
+					ImGui::SliderFloat("CFL Number", &Lagrangian2dPara::cflNumber, 0.05f, 1.0f);
+					ImGui::SliderFloat("Min Delta Time", &Lagrangian2dPara::minDt, 1e-6f, 1e-3f, "%.6f");
+					ImGui::SliderFloat("Max Delta Time", &Lagrangian2dPara::maxDt, 1e-4f, 0.01f, "%.5f");
+					ImGui::Text("Delta Time: %.5f  Steps per Frame: %d", Lagrangian2dPara::stepDt, Lagrangian2dPara::frameSteps);
+					ImGui::PushItemWidth(150);
+				}
+				else
+				{
+					ImGui::SliderFloat("Delta Time", &Lagrangian2dPara::dt, 0.0f, 0.003f, "%.5f");
+					ImGui::PushItemWidth(150);
+					ImGui::InputScalar("Substep", ImGuiDataType_S32, &Lagrangian2dPara::substep, &intStep, NULL);
+				}
+				ImGui::InputScalar("Seed", ImGuiDataType_U32, &Lagrangian2dPara::seed, &intStep, NULL);
+				ImGui::InputScalar("Threads (0 = all)", ImGuiDataType_S32, &Lagrangian2dPara::threads, &intStep, NULL);
+				if (Lagrangian2dPara::threads < 0)
+					Lagrangian2dPara::threads = 0;
+				ImGui::PopItemWidth();
+				ImGui::Checkbox("Neighbour Lists", &Lagrangian2dPara::neighborList);
+				if (Lagrangian2dPara::neighborList)
+				{
+					ImGui::PushItemWidth(150);
+					ImGui::SliderFloat("Skin (x support radius)", &Lagrangian2dPara::neighborSkin, 0.0f, 1.0f);
+					ImGui::PopItemWidth();
+				}
+				else
+				{
+					ImGui::Checkbox("Pair Stream", &Lagrangian2dPara::pairStream);
+				}
+				ImGui::Checkbox("Interpolate Kernel", &Lagrangian2dPara::kernelInterpolation);
+				if (ImGui::Button("Benchmark Block Sort"))
+				{
+					Lagrangian2dPara::benchmarkBlockSort = true;
+					Glb::Logger::getInstance().addLog("Block sort benchmark runs on the next simulation step.");
+				}
+
+				ImGui::Spacing();
+				ImGui::Separator();
+				ImGui::Spacing();
+
+				ImGui::Text("Emitters:");
+				ImGui::Checkbox("Emitter and Sink (on rerun)", &Lagrangian2dPara::emitters);
 				ImGui::PushItemWidth(150);
-				ImGui::InputScalar("Substep", ImGuiDataType_S32, &Lagrangian2dPara::substep, &intStep, NULL);
+				ImGui::InputScalar("Pool Capacity (on rerun)", ImGuiDataType_S32, &Lagrangian2dPara::maxParticleNum, &intStep, NULL);
+				if (Lagrangian2dPara::maxParticleNum < 0)
+					Lagrangian2dPara::maxParticleNum = 0;
 				ImGui::PopItemWidth();
+				ImGui::Text("Particles: %d  Emitters and Sinks: %.3f ms", Lagrangian2dPara::particleNum, Lagrangian2dPara::emissionTime);
+				ImGui::PlotLines("Particle Count", Lagrangian2dPara::particleNumHistory, Lagrangian2dPara::PARTICLE_NUM_HISTORY,
+								 Lagrangian2dPara::particleNumHistoryOffset, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
 
 				break;
 			// eulerian 2d
@@ -124,6 +173,24 @@ namespace FluidSimulation
 				ImGui::PushItemWidth(150);
 				ImGui::SliderFloat("Source Velocity", &Eulerian2dPara::sourceVelocity, 0.0f, 5.0f);
 				ImGui::PopItemWidth();
+				ImGui::Text("Pressure Solver:");
+				ImGui::RadioButton("PCG", &Eulerian2dPara::pressureSolver, 0);
+				ImGui::RadioButton("Multigrid", &Eulerian2dPara::pressureSolver, 1);
+				ImGui::RadioButton("MG-PCG", &Eulerian2dPara::pressureSolver, 2);
+				ImGui::RadioButton("FFT (no solids)", &Eulerian2dPara::pressureSolver, 3);
+				if (Eulerian2dPara::pressureSolver == 0)
+				{
+					ImGui::Text("Preconditioner:");
+					ImGui::RadioButton("IC(0)", &Eulerian2dPara::preconditioner, 0);
+					ImGui::RadioButton("Jacobi", &Eulerian2dPara::preconditioner, 1);
+					ImGui::RadioButton("Incomplete Poisson", &Eulerian2dPara::preconditioner, 2);
+					ImGui::RadioButton("Red-Black MIC(0)", &Eulerian2dPara::preconditioner, 3);
+				}
+				ImGui::PushItemWidth(150);
+				ImGui::InputFloat("Tolerance", &Eulerian2dPara::pressureTolerance, 0.0f, 0.0f, "%.6f");
+				ImGui::PopItemWidth();
+				ImGui::Checkbox("Relative Tolerance", &Eulerian2dPara::relativeTolerance);
+				ImGui::Text("Iterations: %d  Residual: %.2e  Time: %.2f ms", Eulerian2dPara::pressureIterations, Eulerian2dPara::pressureResidual, Eulerian2dPara::pressureTime);
 
 				ImGui::Separator();
 
@@ -150,11 +217,97 @@ namespace FluidSimulation
 				ImGui::Separator();
 
 				ImGui::Text("Solver:");
-				ImGui::SliderFloat("Delta Time", &Lagrangian3dPara::dt, 0.0f, 0.005f, "%.5f");
-				ImGui::PushItemWidth(150);
-				ImGui::InputScalar("Substep", ImGuiDataType_S32, &Lagrangian3dPara::substep, &intStep, NULL);
+				ImGui::Checkbox("Adaptive Time Step", &Lagrangian3dPara::adaptiveTimeStep);
+				if (Lagrangian3dPara::adaptiveTimeStep)
+				{
+					ImGui::SliderFloat("Frame Time", &Lagrangian3dPara::frameTime, 0.0005f, 0.02f, "%.4f");
+					ImGui::SliderFloat("CFL Number", &Lagrangian3dPara::cflNumber, 0.05f, 1.0f);
+					ImGui::SliderFloat("Min Delta Time", &Lagrangian3dPara::minDt, 1e-6f, 1e-3f, "%.6f");
+					ImGui::SliderFloat("Max Delta Time", &Lagrangian3dPara::maxDt, 1e-4f, 0.01f, "%.5f");
+					ImGui::Text("Delta Time: %.5f  Steps per Frame: %d", Lagrangian3dPara::stepDt, Lagrangian3dPara::frameSteps);
+					ImGui::PushItemWidth(150);
+				}
+				else
+				{
+					ImGui::SliderFloat("Delta Time", &Lagrangian3dPara::dt, 0.0f, 0.005f, "%.5f");
+					ImGui::PushItemWidth(150);
+					ImGui::InputScalar("Substep", ImGuiDataType_S32, &Lagrangian3dPara::substep, &intStep, NULL);
+				}
 				ImGui::InputScalar("Velocity Attenuation", ImGuiDataType_Float, &Lagrangian3dPara::velocityAttenuation, &floatStep, NULL);
+				ImGui::InputScalar("Seed", ImGuiDataType_U32, &Lagrangian3dPara::seed, &intStep, NULL);
+				ImGui::InputScalar("Threads (0 = all)", ImGuiDataType_S32, &Lagrangian3dPara::threads, &intStep, NULL);
+				if (Lagrangian3dPara::threads < 0)
+					Lagrangian3dPara::threads = 0;
 				ImGui::PopItemWidth();
+				ImGui::Checkbox("Neighbour Lists", &Lagrangian3dPara::neighborList);
+				if (Lagrangian3dPara::neighborList)
+				{
+					ImGui::PushItemWidth(150);
+					ImGui::SliderFloat("Skin (x support radius)", &Lagrangian3dPara::neighborSkin, 0.0f, 1.0f);
+					ImGui::PopItemWidth();
+				}
+				else
+				{
+					ImGui::Checkbox("Pair Stream", &Lagrangian3dPara::pairStream);
+				}
+				if (ImGui::Button("Benchmark Block Sort"))
+				{
+					Lagrangian3dPara::benchmarkBlockSort = true;
+					Glb::Logger::getInstance().addLog("Block sort benchmark runs on the next simulation step.");
+				}
+				ImGui::Text("Block Order:");
+				ImGui::RadioButton("Row-major", &Lagrangian3dPara::blockOrder, 0);
+				ImGui::RadioButton("Morton", &Lagrangian3dPara::blockOrder, 1);
+				ImGui::Checkbox("Sparse Grid", &Lagrangian3dPara::sparseGrid);
+				ImGui::Text("Pair Loops:");
+				ImGui::RadioButton("Scalar", &Lagrangian3dPara::simd, 0);
+				ImGui::RadioButton("AVX2", &Lagrangian3dPara::simd, 1);
+				ImGui::RadioButton("AVX-512", &Lagrangian3dPara::simd, 2);
+				ImGui::Text("Pressure Solver:");
+				ImGui::RadioButton("Equation of State", &Lagrangian3dPara::pressureSolver, 0);
+				ImGui::RadioButton("DFSPH", &Lagrangian3dPara::pressureSolver, 1);
+				if (Lagrangian3dPara::pressureSolver == 1)
+				{
+					ImGui::PushItemWidth(150);
+					ImGui::SliderFloat("Density Tolerance", &Lagrangian3dPara::densityTolerance, 1e-4f, 0.01f, "%.4f");
+					ImGui::SliderFloat("Divergence Tolerance", &Lagrangian3dPara::divergenceTolerance, 1e-4f, 0.01f, "%.4f");
+					ImGui::InputScalar("Max Iterations", ImGuiDataType_S32, &Lagrangian3dPara::maxPressureIterations, &intStep, NULL);
+					if (Lagrangian3dPara::maxPressureIterations < 1)
+						Lagrangian3dPara::maxPressureIterations = 1;
+					ImGui::PopItemWidth();
+					ImGui::Text("Iterations: %d density, %d divergence  Compression: %.3f%%", Lagrangian3dPara::densityIterations,
+								Lagrangian3dPara::divergenceIterations, 100.0f * Lagrangian3dPara::densityError);
+				}
+				if (ImGui::Button("Benchmark Pressure Solvers"))
+				{
+					Lagrangian3dPara::benchmarkPressureSolver = true;
+					Glb::Logger::getInstance().addLog("Pressure solver benchmark runs on the next simulation step.");
+				}
+				ImGui::Checkbox("Sleeping Blocks", &Lagrangian3dPara::sleepingBlocks);
+				if (Lagrangian3dPara::sleepingBlocks)
+				{
+					ImGui::PushItemWidth(150);
+					ImGui::SliderFloat("Sleep Velocity", &Lagrangian3dPara::sleepVelocity, 0.0f, 0.5f, "%.3f");
+					ImGui::SliderFloat("Sleep Acceleration", &Lagrangian3dPara::sleepAccleration, 0.0f, 200.0f);
+					ImGui::InputScalar("Sleep Steps", ImGuiDataType_S32, &Lagrangian3dPara::sleepSteps, &intStep, NULL);
+					if (Lagrangian3dPara::sleepSteps < 1)
+						Lagrangian3dPara::sleepSteps = 1;
+					ImGui::PopItemWidth();
+					ImGui::Text("Active Particles: %.1f%%", 100.0f * Lagrangian3dPara::activeFraction);
+				}
+
+				ImGui::Separator();
+
+				ImGui::Text("Emitters:");
+				ImGui::Checkbox("Emitter and Sink (on rerun)", &Lagrangian3dPara::emitters);
+				ImGui::PushItemWidth(150);
+				ImGui::InputScalar("Pool Capacity (on rerun)", ImGuiDataType_S32, &Lagrangian3dPara::maxParticleNum, &intStep, NULL);
+				if (Lagrangian3dPara::maxParticleNum < 0)
+					Lagrangian3dPara::maxParticleNum = 0;
+				ImGui::PopItemWidth();
+				ImGui::Text("Particles: %d  Emitters and Sinks: %.3f ms", Lagrangian3dPara::particleNum, Lagrangian3dPara::emissionTime);
+				ImGui::PlotLines("Particle Count", Lagrangian3dPara::particleNumHistory, Lagrangian3dPara::PARTICLE_NUM_HISTORY,
+								 Lagrangian3dPara::particleNumHistoryOffset, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
 
 				ImGui::Separator();
 
@@ -221,6 +374,24 @@ namespace FluidSimulation
 				ImGui::SliderFloat("Delta Time", &Eulerian3dPara::dt, 0.0f, 0.1f, "%.5f");
 				ImGui::SliderFloat("Source Velocity", &Eulerian3dPara::sourceVelocity, 0.0f, 5.0f);
 				ImGui::PopItemWidth();
+				ImGui::Text("Pressure Solver:");
+				ImGui::RadioButton("PCG", &Eulerian3dPara::pressureSolver, 0);
+				ImGui::RadioButton("Multigrid", &Eulerian3dPara::pressureSolver, 1);
+				ImGui::RadioButton("MG-PCG", &Eulerian3dPara::pressureSolver, 2);
+				ImGui::RadioButton("FFT (no solids)", &Eulerian3dPara::pressureSolver, 3);
+				if (Eulerian3dPara::pressureSolver == 0)
+				{
+					ImGui::Text("Preconditioner:");
+					ImGui::RadioButton("IC(0)", &Eulerian3dPara::preconditioner, 0);
+					ImGui::RadioButton("Jacobi", &Eulerian3dPara::preconditioner, 1);
+					ImGui::RadioButton("Incomplete Poisson", &Eulerian3dPara::preconditioner, 2);
+					ImGui::RadioButton("Red-Black MIC(0)", &Eulerian3dPara::preconditioner, 3);
+				}
+				ImGui::PushItemWidth(150);
+				ImGui::InputFloat("Tolerance", &Eulerian3dPara::pressureTolerance, 0.0f, 0.0f, "%.6f");
+				ImGui::PopItemWidth();
+				ImGui::Checkbox("Relative Tolerance", &Eulerian3dPara::relativeTolerance);
+				ImGui::Text("Iterations: %d  Residual: %.2e  Time: %.2f ms", Eulerian3dPara::pressureIterations, Eulerian3dPara::pressureResidual, Eulerian3dPara::pressureTime);
 
 				ImGui::Separator();
 